@@ -12,10 +12,10 @@ struct CollisionData_Triangle
     math::vec3 p[3];
     math::vec3 v[3];
     float m[3];
-    size_t i[3]; // lms indices
+    LinearHandle i[3]; // lms handles
 
     CollisionData_Triangle();
-    CollisionData_Triangle(size_t i1, size_t i2, size_t i3, float m1, float m2, float m3);
+    CollisionData_Triangle(LinearHandle i1, LinearHandle i2, LinearHandle i3, float m1, float m2, float m3);
     void updateData(LinearMotionSystem& _lms);
 };
 
@@ -24,10 +24,10 @@ struct CollisionData_Edge
     math::vec3 p[2];
     math::vec3 v[2];
     float m[2];
-    size_t i[2]; // lms indices
+    LinearHandle i[2]; // lms handles
 
     CollisionData_Edge();
-    CollisionData_Edge(size_t i1, size_t i2, float m1, float m2);
+    CollisionData_Edge(LinearHandle i1, LinearHandle i2, float m1, float m2);
     void updateData(LinearMotionSystem& _lms);
 };
 
@@ -36,11 +36,11 @@ struct CollisionData_Point
     math::vec3 p;
     math::vec3 v;
     float m;
-    size_t i; // lms indice
+    LinearHandle i; // lms handle
 
     CollisionData_Point();
-    CollisionData_Point(size_t lms_indice, float mass);
-    CollisionData_Point(size_t lms_indice, float mass, const math::vec3& position, const math::vec3& velocity);
+    CollisionData_Point(LinearHandle lms_handle, float mass);
+    CollisionData_Point(LinearHandle lms_handle, float mass, const math::vec3& position, const math::vec3& velocity);
     void updateData(LinearMotionSystem& _lms);
 };
 
@@ -69,13 +69,15 @@ struct ClothCollisionModel final : public Object3D
     std::vector<AABB*> triangleBoxes;
     AABB* root;
     LinearMotionSystem& _lms;
+    const Cloth* cloth = nullptr;
     float thickness;
     float stiffness = 1.f;
 
     gl::GLuint VAO = 0;
     gl::GLuint VBO = 0;
     std::shared_ptr<Program> program;
-    std::vector<gl::GLfloat> toDraw;
+    std::vector<gl::GLfloat> toDraw;                            // <- filled by the physics thread
+    mutable TripleBuffer<std::vector<gl::GLfloat>> drawSnapshots; // <- toDraw as last published, read by render()
 
     int nbrOfCollisions = 0;
 
@@ -88,7 +90,8 @@ struct ClothCollisionModel final : public Object3D
     void render(const math::mat & projMatrix) const override;
     void updateAllTriangleData();
     void updateTriangleData(size_t i, bool updateAABB = true, bool updateParents = true);
-    void resolveInternalCollisions();
-    void resolveTriangleTriangleCollision(LinearMotionSystem& _lms, CollisionData_Triangle& t1, CollisionData_Triangle& t2);
-    bool resolvePointTriangleCollision(LinearMotionSystem& _lms, CollisionData_Point& p, CollisionData_Triangle& t, float threshold, float stiffnessCoefficient);
+    void resolveInternalCollisions(float dt);
+    void publish();
+    void resolveTriangleTriangleCollision(LinearMotionSystem& _lms, CollisionData_Triangle& t1, CollisionData_Triangle& t2, float dt);
+    bool resolvePointTriangleCollision(LinearMotionSystem& _lms, CollisionData_Point& p, CollisionData_Triangle& t, float threshold, float stiffnessCoefficient, float dt);
 };
@@ -4,11 +4,34 @@
 #include "3D/openGL.h"
 #include "3D/shader.h"
 #include "maths/math.h"
+#include "physics/edge_kernels.h"
 #include "physics/motion_system.h"
+#include "physics/triangle_kernels.h"
+#include "tools/triple_buffer.h"
+
+#include <vector>
 
-#define USE_IMPULSE
 #define USE_IMPULSE_TO_FIX_POINTS
-//#define UPDATE_ALL_AT_ONCE
+
+// How the constraints of a cloth are combined. GAUSS_SEIDEL moves the points right after each constraint, colour by
+// colour. JACOBI computes every constraint from the same positions into its own slots of a buffer, then sums the slots
+// of each point through the point-to-constraint adjacency: no colouring, and a fixed summation order whatever the
+// number of threads.
+enum class ConstraintSolver
+{
+    GAUSS_SEIDEL,
+    JACOBI
+};
+
+// How a constraint turns into a correction. PBD moves the points a `stiffness` share of the way back each iteration,
+// so the material gets stiffer with more steps or iterations. XPBD gives each constraint a compliance, the inverse of
+// its stiffness, and accumulates its Lagrange multiplier over the iterations of a step: the material only depends on
+// the compliance, and substeps can be traded for iterations without retuning it.
+enum class ConstraintModel
+{
+    PBD,
+    XPBD
+};
 
 struct Cloth final : public Object3D
 {
@@ -21,26 +44,93 @@ struct Cloth final : public Object3D
     float triangleStiffness;
     float edgeStiffness;
     float thickness;
+    float totalMass;
     size_t nbrOfPoints;
     size_t nbrOfTriangles;
     size_t nbrOfEdges;
     size_t width;
 
-    size_t* triangles;
-    size_t* edges;
+    size_t* triangles; // <- sorted by colour: the triangles of a colour share no vertex and are solved in parallel
+    size_t* edges;     // <- sorted by colour as well
+    std::vector<size_t> triangleColourStart; // <- colour c is [triangleColourStart[c], triangleColourStart[c + 1])
+    std::vector<size_t> edgeColourStart;
+    ConstraintSolver solver;
+    ConstraintModel model;
+    float triangleCompliance; // <- XPBD: of each corner held to its shape matching goal
+    float edgeCompliance;     // <- XPBD: of each edge length, < 0 leaves the edges out
+    float stepInvDt2;         // <- XPBD: 1 / dt^2 of the step being solved
+    std::vector<size_t> pointTriangleStart; // <- CSR: slots of point n are pointTriangleSlot[pointTriangleStart[n], pointTriangleStart[n + 1])
+    std::vector<size_t> pointTriangleSlot;  // <- 3 * triangle + corner, sorted
+    std::vector<size_t> pointEdgeStart;
+    std::vector<size_t> pointEdgeSlot;      // <- 2 * edge + end, sorted
+    std::vector<math::vec3> triangleOffset; // <- JACOBI: offset of every triangle corner, 3 per triangle
+    std::vector<math::vec3> edgeOffset;     // <- JACOBI: offset of every edge end, 2 per edge
+
+    // JACOBI: iterations per step, accelerated by the Chebyshev semi-iterative method when the spectral radius rho of
+    // the plain iteration is given. rho = 0 keeps plain Jacobi, rho < 0 runs the first CHEBYSHEV_PROBE_STEPS steps
+    // plain and estimates it from how fast their offsets shrink.
+    static constexpr int CHEBYSHEV_PROBE_STEPS = 16;
+    static constexpr float CHEBYSHEV_MAX_RHO = .99f; // <- omega grows without bound as rho reaches 1
+    int solverIterations;
+    float chebyshevRho;
+    float estimatedRho; // <- < 0 until the probe is done
+    std::array<float, CHEBYSHEV_PROBE_STEPS> probedRho;
+    int probedSteps;
+    std::vector<math::vec3> jacobiPrevious; // <- position of every point one iteration back
+    std::vector<float> jacobiResidual;      // <- squared offset of every point at the last iteration
     float* invNbrAdjTriangles;
     float* invNbrAdjEdges;
     float* mass;
+    std::vector<size_t> fixedPoints; // <- pinned to their initial position
+
+    // Rest state of a triangle in its own plane, only depends on posInit and the masses. 32 bytes, two per cache line.
+    struct alignas(32) TriangleRest
+    {
+        math::mat2x3 coord; // <- columns are the 2D coordinates of the points around the rest center of mass
+        float invTotalMass;
+    };
+    aligned_unique_ptr<TriangleRest[]> triangleRest;
+
+    // PACKETS: the triangles of each colour packed by TrianglePacket::SIZE for the SIMD shape matching kernel, in the
+    // colour order. A packet never holds two colours, so that its lanes share no vertex and can all be applied at once.
+    aligned_unique_ptr<TrianglePacket[]>  trianglePackets;
+    aligned_unique_ptr<TriangleOffsets[]> packetOffsets;
+    std::vector<size_t> packetColourStart; // <- packets of colour c are [packetColourStart[c], packetColourStart[c + 1])
+    aligned_unique_ptr<EdgePacket[]>      edgePackets; // <- same for the edges
+    aligned_unique_ptr<EdgeOffsets[]>     edgePacketOffsets;
+    std::vector<size_t> edgePacketColourStart;
+    std::vector<math::vec3> positionScratch; // <- positions the packets read, gathered from the particles
+    aligned_unique_ptr<TriangleLambdas[]> triangleLambdas; // <- XPBD: one per packet, zeroed every step
+    aligned_unique_ptr<EdgeLambdas[]>     edgeLambdas;
+
+    // REGIONS: hierarchy of vertex neighbourhoods matched as rigid 3D shapes, on top of the triangles. Level 1 has a
+    // region per vertex holding its 1-ring, level l keeps vertices about 2^(l - 1) rings apart and grows their regions
+    // to the same radius, so that the coarse levels take the low frequency stretching out in a single pass.
+    static constexpr int REGION_ROTATION_ITERATIONS = 4; // <- upper bound, a warm started region needs one or two
+    float regionStiffness;
+    int regionLevels;                       // <- 0 keeps the triangles alone
+    std::vector<size_t>     levelStart;     // <- regions of level l are [levelStart[l - 1], levelStart[l])
+    std::vector<size_t>     regionStart;    // <- members of region r are regionMembers[regionStart[r], regionStart[r + 1])
+    std::vector<size_t>     regionMembers;
+    std::vector<math::vec3> regionRest;     // <- rest offset of each member from the rest center of mass of its region
+    std::vector<float>      regionInvMass;
+    std::vector<float>      regionWeight;   // <- of each member, 1 / number of regions of the level holding the vertex
+    std::vector<math::quat> regionRotation; // <- rotation found at the last step, warm start of the next extraction
+    std::vector<math::vec3> regionScratch;  // <- positions of the members of the region being matched
 
     // DYNAMIC VARIABLES
     math::vec3* posInit;
-    size_t* posCur;
+    LinearBlock particles; // <- vertex n is particle n of the block
+    mutable TripleBuffer<std::vector<math::vec3>> snapshots; // positions published by the physics thread for render()
     gl::GLfloat* vertex_t; // only positions, use IBO
     gl::GLfloat* vertex_e; // only positions, no IBO because 1 color per edge
+    bool sleeping;         // the particles are stopped, update() only watches for a disturbance
+    float windowTime;      // time since windowStart was taken
+    math::vec3* windowStart; // positions at the start of the current sleep detection window
 
-#ifdef UPDATE_ALL_AT_ONCE
-  math::vec3 * correction;
-#endif
+    static constexpr size_t PARALLEL_GRAIN_CONSTRAINTS = 64;                          // constraints per worker range
+    static constexpr size_t PARALLEL_MIN_CONSTRAINTS = 4 * PARALLEL_GRAIN_CONSTRAINTS; // below this a colour stays serial
+    static constexpr size_t PARALLEL_GRAIN_PACKETS = PARALLEL_GRAIN_CONSTRAINTS / TrianglePacket::SIZE;
 
     // OPENGL VARIABLES
     static constexpr size_t UNIFORM_COLOR = 0;
@@ -55,8 +145,22 @@ struct Cloth final : public Object3D
     void updateMass();
     void setDensity(float _density);
     void setStiffness(float triangle, float edge);
+    void setRegionStiffness(float region);
+    void setRegionLevels(int levels);
+    void setConstraintSolver(ConstraintSolver _solver);
+    void setSolverIterations(int iterations); // <- JACOBI only
+    void setChebyshevRho(float rho);          // <- JACOBI + PBD only, < 0 estimates it, ignored under XPBD
+    void setConstraintModel(ConstraintModel _model);
+    void setCompliance(float triangle, float edge); // <- XPBD only, the regions stay PBD
     void setThickness(float _thickness);
     void updateNbrTriangleAndEdgePerPoint();
+    void colourConstraints(); // <- reorders triangles and edges
+    void updatePointAdjacency();
+    void updateTriangleRest(); // <- depends on the masses
+    void updateTrianglePackets(); // <- depends on the rest state and the colours
+    void updateEdgePackets();     // <- depends on the masses, the stiffness, the compliance and the colours
+    void initRegions();
+    void updateRegionRest(); // <- depends on the masses
 
     explicit Cloth(LinearMotionSystem& lms);
     Cloth(LinearMotionSystem& lms, const math::vec3& pos, const math::vec3& axis_h, const math::vec3& axis_w, size_t size_h, size_t size_w, float step_h, float step_w);
@@ -65,8 +169,17 @@ struct Cloth final : public Object3D
     void initGL(std::shared_ptr<Program> uniformColorProgram, std::shared_ptr<Program> strainColorProgram);
     void render(const math::mat& projMatrix) const override;
 
-    void applyTriangleShapeMatching(size_t iTriangle);
-    void triangle2DCorrection(size_t iTriangle);
-    void edgeCorrection(size_t iEdge);
-    void update();
+    void shapeMatchPackets(size_t begin, size_t end); // <- into packetOffsets, from positionScratch
+    void solveTrianglesByColour();
+    void solveTrianglesJacobi();
+    void distancePackets(size_t begin, size_t end); // <- into edgePacketOffsets, from positionScratch
+    void solveEdgesByColour();
+    void solveEdgesJacobi();
+    [[nodiscard]] bool solvesEdges() const;
+    void applyRegionShapeMatching(size_t iRegion);
+    void update(float dt);
+    void publish(); // <- physics thread, once all the substeps of a frame are done
+    void sleep();
+    void wake();
+    [[nodiscard]] bool isSleeping() const { return sleeping; }
 };
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "common.h"
+#include "vector.h"
+#include "matrix.h"
+
+namespace math
+{
+    // Row-major R x C matrix with inline storage: no heap allocation, trivially copyable, dimensions known at compile
+    // time so that every loop below is unrolled. Meant for the solver hot paths, math::mat remains for matrices whose
+    // size is only known at runtime.
+    template <int R, int C>
+    struct mat_fixed
+    {
+        static constexpr int nbrOfRow = R;
+        static constexpr int nbrOfCol = C;
+
+        float data[R * C];
+
+        constexpr mat_fixed()
+            : data{}
+        { }
+
+        // `scalar` on the diagonal, 0 elsewhere, as math::mat(row, col, scalar)
+        explicit constexpr mat_fixed(float scalar)
+            : data{}
+        {
+            for (int n = 0; n < (R < C ? R : C); n++) data[n * C + n] = scalar;
+        }
+
+        float* operator[](int row) { return data + row * C; }
+        const float* operator[](int row) const { return data + row * C; }
+
+        mat_fixed operator*(float scalar) const
+        {
+            mat_fixed r;
+            for (int n = 0; n < R * C; n++) r.data[n] = data[n] * scalar;
+            return r;
+        }
+
+        mat_fixed operator/(float scalar) const
+        {
+            return (*this) * (1.f / scalar);
+        }
+
+        void operator*=(float scalar)
+        {
+            for (int n = 0; n < R * C; n++) data[n] *= scalar;
+        }
+
+        mat_fixed operator+(const mat_fixed& m) const
+        {
+            mat_fixed r;
+            for (int n = 0; n < R * C; n++) r.data[n] = data[n] + m.data[n];
+            return r;
+        }
+
+        mat_fixed operator-(const mat_fixed& m) const
+        {
+            mat_fixed r;
+            for (int n = 0; n < R * C; n++) r.data[n] = data[n] - m.data[n];
+            return r;
+        }
+
+        void operator+=(const mat_fixed& m)
+        {
+            for (int n = 0; n < R * C; n++) data[n] += m.data[n];
+        }
+
+        void operator-=(const mat_fixed& m)
+        {
+            for (int n = 0; n < R * C; n++) data[n] -= m.data[n];
+        }
+
+        mat_fixed<C, R> transpose() const
+        {
+            mat_fixed<C, R> r;
+            for (int row = 0; row < R; row++)
+                for (int col = 0; col < C; col++)
+                    r.data[col * R + row] = data[row * C + col];
+            return r;
+        }
+
+        static mat_fixed<C, R> transpose(const mat_fixed& m)
+        {
+            return m.transpose();
+        }
+
+        // copy into a heap matrix, for the code that still works with math::mat
+        mat to_mat() const
+        {
+            mat r(R, C);
+            for (int n = 0; n < R * C; n++) r.data[n] = data[n];
+            return r;
+        }
+    };
+
+    using mat2   = mat_fixed<2, 2>;
+    using mat2x3 = mat_fixed<2, 3>; // <- 2 rows, 3 columns
+    using mat3   = mat_fixed<3, 3>;
+    using mat4   = mat_fixed<4, 4>;
+
+    template <int R, int K, int C>
+    inline mat_fixed<R, C> operator*(const mat_fixed<R, K>& a, const mat_fixed<K, C>& b)
+    {
+        mat_fixed<R, C> r;
+        for (int row = 0; row < R; row++)
+            for (int col = 0; col < C; col++)
+            {
+                float element = 0.f;
+                for (int n = 0; n < K; n++) element += a.data[row * K + n] * b.data[n * C + col];
+                r.data[row * C + col] = element;
+            }
+        return r;
+    }
+
+    template <int R>
+    inline mat_fixed<R, 1> operator*(const mat_fixed<R, 3>& m, const vec3& v)
+    {
+        mat_fixed<R, 1> r;
+        for (int row = 0; row < R; row++) r.data[row] = m.data[3 * row] * v.x + m.data[3 * row + 1] * v.y + m.data[3 * row + 2] * v.z;
+        return r;
+    }
+
+    // Written out products for the sizes the solvers use. Being plain functions, they win over the template above.
+
+    inline mat2 operator*(const mat2& a, const mat2& b)
+    {
+        mat2 r;
+        r.data[0] = a.data[0] * b.data[0] + a.data[1] * b.data[2];
+        r.data[1] = a.data[0] * b.data[1] + a.data[1] * b.data[3];
+        r.data[2] = a.data[2] * b.data[0] + a.data[3] * b.data[2];
+        r.data[3] = a.data[2] * b.data[1] + a.data[3] * b.data[3];
+        return r;
+    }
+
+    inline mat2x3 operator*(const mat2& a, const mat2x3& b)
+    {
+        mat2x3 r;
+        for (int col = 0; col < 3; col++)
+        {
+            r.data[col] = a.data[0] * b.data[col] + a.data[1] * b.data[3 + col];
+            r.data[3 + col] = a.data[2] * b.data[col] + a.data[3] * b.data[3 + col];
+        }
+        return r;
+    }
+
+    inline mat3 operator*(const mat3& a, const mat3& b)
+    {
+        mat3 r;
+        for (int row = 0; row < 3; row++)
+        {
+            const float* ar = a.data + 3 * row;
+            r.data[3 * row] = ar[0] * b.data[0] + ar[1] * b.data[3] + ar[2] * b.data[6];
+            r.data[3 * row + 1] = ar[0] * b.data[1] + ar[1] * b.data[4] + ar[2] * b.data[7];
+            r.data[3 * row + 2] = ar[0] * b.data[2] + ar[1] * b.data[5] + ar[2] * b.data[8];
+        }
+        return r;
+    }
+
+    inline mat4 operator*(const mat4& a, const mat4& b)
+    {
+        mat4 r;
+        for (int row = 0; row < 4; row++)
+        {
+            const float* ar = a.data + 4 * row;
+            for (int col = 0; col < 4; col++)
+            {
+                r.data[4 * row + col] = ar[0] * b.data[col] + ar[1] * b.data[4 + col] + ar[2] * b.data[8 + col] + ar[3] * b.data[12 + col];
+            }
+        }
+        return r;
+    }
+
+    inline vec3 operator*(const mat3& m, const vec3& v)
+    {
+        return {
+            m.data[0] * v.x + m.data[1] * v.y + m.data[2] * v.z,
+            m.data[3] * v.x + m.data[4] * v.y + m.data[5] * v.z,
+            m.data[6] * v.x + m.data[7] * v.y + m.data[8] * v.z
+        };
+    }
+
+    inline float determinant(const mat2& m)
+    {
+        return m.data[0] * m.data[3] - m.data[1] * m.data[2];
+    }
+
+    inline float determinant(const mat3& m)
+    {
+        return m.data[0] * (m.data[4] * m.data[8] - m.data[5] * m.data[7])
+             - m.data[1] * (m.data[3] * m.data[8] - m.data[5] * m.data[6])
+             + m.data[2] * (m.data[3] * m.data[7] - m.data[4] * m.data[6]);
+    }
+
+    // Closed-form inverses (adjugate over determinant). A singular matrix gives a zero matrix rather than infinities,
+    // the callers treat it as "no correction".
+
+    inline mat2 inverse(const mat2& m)
+    {
+        const float det = determinant(m);
+        mat2 r;
+        if (det != 0.f)
+        {
+            const float invDet = 1.f / det;
+            r.data[0] = m.data[3] * invDet;
+            r.data[1] = -m.data[1] * invDet;
+            r.data[2] = -m.data[2] * invDet;
+            r.data[3] = m.data[0] * invDet;
+        }
+        return r;
+    }
+
+    inline mat3 inverse(const mat3& m)
+    {
+        const float det = determinant(m);
+        mat3 r;
+        if (det != 0.f)
+        {
+            const float invDet = 1.f / det;
+            r.data[0] = (m.data[4] * m.data[8] - m.data[5] * m.data[7]) * invDet;
+            r.data[1] = (m.data[2] * m.data[7] - m.data[1] * m.data[8]) * invDet;
+            r.data[2] = (m.data[1] * m.data[5] - m.data[2] * m.data[4]) * invDet;
+            r.data[3] = (m.data[5] * m.data[6] - m.data[3] * m.data[8]) * invDet;
+            r.data[4] = (m.data[0] * m.data[8] - m.data[2] * m.data[6]) * invDet;
+            r.data[5] = (m.data[2] * m.data[3] - m.data[0] * m.data[5]) * invDet;
+            r.data[6] = (m.data[3] * m.data[7] - m.data[4] * m.data[6]) * invDet;
+            r.data[7] = (m.data[1] * m.data[6] - m.data[0] * m.data[7]) * invDet;
+            r.data[8] = (m.data[0] * m.data[4] - m.data[1] * m.data[3]) * invDet;
+        }
+        return r;
+    }
+
+    inline mat4 inverse(const mat4& m)
+    {
+        const float* a = m.data;
+
+        // 2x2 sub-determinants of the two upper rows (s) and of the two lower rows (c)
+        const float s0 = a[0] * a[5] - a[4] * a[1];
+        const float s1 = a[0] * a[6] - a[4] * a[2];
+        const float s2 = a[0] * a[7] - a[4] * a[3];
+        const float s3 = a[1] * a[6] - a[5] * a[2];
+        const float s4 = a[1] * a[7] - a[5] * a[3];
+        const float s5 = a[2] * a[7] - a[6] * a[3];
+
+        const float c5 = a[10] * a[15] - a[14] * a[11];
+        const float c4 = a[9] * a[15] - a[13] * a[11];
+        const float c3 = a[9] * a[14] - a[13] * a[10];
+        const float c2 = a[8] * a[15] - a[12] * a[11];
+        const float c1 = a[8] * a[14] - a[12] * a[10];
+        const float c0 = a[8] * a[13] - a[12] * a[9];
+
+        const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+        mat4 r;
+        if (det != 0.f)
+        {
+            const float invDet = 1.f / det;
+            r.data[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * invDet;
+            r.data[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * invDet;
+            r.data[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * invDet;
+            r.data[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * invDet;
+
+            r.data[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * invDet;
+            r.data[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * invDet;
+            r.data[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * invDet;
+            r.data[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * invDet;
+
+            r.data[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * invDet;
+            r.data[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * invDet;
+            r.data[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * invDet;
+            r.data[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * invDet;
+
+            r.data[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * invDet;
+            r.data[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * invDet;
+            r.data[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * invDet;
+            r.data[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * invDet;
+        }
+        return r;
+    }
+}
@@ -2,5 +2,8 @@
 
 #include "common.h"
 #include "vector.h"
+#include "vec3a.h"
 #include "matrix.h"
+#include "fixed_matrix.h"
+#include "polar.h"
 #include "quaternion.h"
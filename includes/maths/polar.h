@@ -0,0 +1,108 @@
+#pragma once
+
+#include "common.h"
+#include "fixed_matrix.h"
+#include "simd.h"
+
+#include <cmath>
+
+namespace math
+{
+    // Rotation of polar_decomposition() below, lane-wise for the kernels. The bias gives the matrices for which both
+    // sums are 0 the identity, without a branch.
+    template <typename RegisterType>
+    void polar_rotation(RegisterType a00, RegisterType a01, RegisterType a10, RegisterType a11, RegisterType& cos, RegisterType& sin)
+    {
+        using S = SIMD<RegisterType>;
+        const RegisterType c = S::add(S::add(a00, a11), S::set1(1e-18f));
+        const RegisterType s = S::sub(a10, a01);
+        const RegisterType length = S::sqrt(S::mul_add(c, c, S::mul(s, s)));
+        cos = S::div(c, length);
+        sin = S::div(s, length);
+    }
+
+    // A = rotation * stretch, with stretch symmetric. The rotation maximises trace(rotation^T * A): its cosine and sine
+    // are a00 + a11 and a10 - a01 normalized, which needs neither atan2 nor cos / sin. A matrix for which both are 0
+    // has no preferred rotation and gets the identity.
+    struct polar2
+    {
+        float cos;
+        float sin;
+        mat2  stretch;
+
+        mat2 rotation() const
+        {
+            mat2 r;
+            r.data[0] = cos;
+            r.data[1] = -sin;
+            r.data[2] = sin;
+            r.data[3] = cos;
+            return r;
+        }
+    };
+
+    inline polar2 polar_decomposition(const mat2& a)
+    {
+        const float c = a.data[0] + a.data[3];
+        const float s = a.data[2] - a.data[1];
+        const float r2 = c * c + s * s;
+
+        polar2 p{ 1.f, 0.f, a };
+        if (r2 > 0.f)
+        {
+            const float invR = 1.f / std::sqrt(r2);
+            p.cos = c * invR;
+            p.sin = s * invR;
+            p.stretch = p.rotation().transpose() * a;
+        }
+        return p;
+    }
+
+    // A = u * diag(sigma) * v^T with u and v rotations and |sigma[0]| >= |sigma[1]|. Keeping u and v proper rotations
+    // means sigma[1] is negative when A flips the orientation (det(A) < 0), which is what the shape matching and
+    // inversion handling want. Built from the polar decomposition and a closed-form Jacobi rotation of the stretch.
+    struct svd2
+    {
+        mat2  u;
+        float sigma[2];
+        mat2  v;
+    };
+
+    inline svd2 singular_value_decomposition(const mat2& a)
+    {
+        const polar2 p = polar_decomposition(a);
+        const float s00 = p.stretch.data[0];
+        const float s01 = .5f * (p.stretch.data[1] + p.stretch.data[2]); // <- symmetric up to rounding
+        const float s11 = p.stretch.data[3];
+
+        // rotation [c s; -s c] diagonalising the stretch, t = tan(angle) taken as the root of smaller magnitude
+        float c = 1.f, s = 0.f, t = 0.f;
+        if (s01 != 0.f)
+        {
+            const float tau = (s11 - s00) / (2.f * s01);
+            t = (tau >= 0.f ? 1.f : -1.f) / (std::fabs(tau) + std::sqrt(1.f + tau * tau));
+            c = 1.f / std::sqrt(1.f + t * t);
+            s = t * c;
+        }
+
+        svd2 d;
+        d.sigma[0] = s00 - t * s01;
+        d.sigma[1] = s11 + t * s01;
+        d.v.data[0] = c;
+        d.v.data[1] = s;
+        d.v.data[2] = -s;
+        d.v.data[3] = c;
+        if (std::fabs(d.sigma[1]) > std::fabs(d.sigma[0])) // <- swap the columns, negate one to stay a rotation
+        {
+            const float sigma = d.sigma[0];
+            d.sigma[0] = d.sigma[1];
+            d.sigma[1] = sigma;
+            d.v.data[0] = s;
+            d.v.data[1] = -c;
+            d.v.data[2] = c;
+            d.v.data[3] = s;
+        }
+        d.u = p.rotation() * d.v;
+        return d;
+    }
+}
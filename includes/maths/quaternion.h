@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.h"
+#include "fixed_matrix.h"
 
 namespace math
 {
@@ -24,11 +25,17 @@ namespace math
         /*quat conjugate() const;
         quat reciprocal() const;
         float unsqrt_norm() const;
-        float norm() const;
         bool is_unit() const;*/
+        float norm() const;
+        quat normalized() const;
+        mat3 toMat3() const; // <- rotation matrix of a unit quaternion
 
         static quat R_quat(float radian, const vec3& axis);
         static quat extractQuat(const mat& m);
+        // Rotation closest to `a` (the rotational part of its polar decomposition), found iteratively from `warmStart`:
+        // each iteration turns the estimate by the torque its columns feel towards the columns of `a`. Starting from
+        // the rotation of the previous step usually converges in one or two iterations.
+        static quat extractRotation(const mat3& a, const quat& warmStart, int maxIterations);
         static quat slerp(const quat& q1, const quat& q2, float alpha);
     };
 }
\ No newline at end of file
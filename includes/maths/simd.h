@@ -1,17 +1,73 @@
 #pragma once
 
 #include <immintrin.h>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
+#include <type_traits>
 
 template <typename RegisterType>
 struct SIMD;
 
+// Each specialization exposes the handful of lane-wise operations the kernels need. The operations are only
+// declared when the compiler targets the matching instruction set, so that a kernel can never be instantiated
+// for a register type the build cannot execute. gather(base, index) loads base[index[k]] into lane k, `index` being
+// aligned like a float array of the register.
+
+// Single lane fallback, lets a kernel written against the trait handle the particles that do not fill a register.
+template <>
+struct SIMD<float>
+{
+    static constexpr size_t width = 1;
+    static constexpr size_t alignment = alignof(float);
+
+    static float load(const float* p) { return *p; }
+    static void store(float* p, float a) { *p = a; }
+    static float set1(float f) { return f; }
+    static float zero() { return 0.f; }
+    static float add(float a, float b) { return a + b; }
+    static float sub(float a, float b) { return a - b; }
+    static float mul(float a, float b) { return a * b; }
+    static float mul_add(float a, float b, float c) { return a * b + c; }
+    static float div(float a, float b) { return a / b; }
+    static float sqrt(float a) { return std::sqrt(a); }
+    static float rsqrt(float a) { return 1.f / std::sqrt(a); }
+    static float max(float a, float b) { return a > b ? a : b; }
+    static float reduce_max(float a) { return a; }
+    static float gather(const float* base, const int32_t* index) { return base[*index]; }
+};
+
 template <>
 struct SIMD<__m128>
 {
     static constexpr size_t width = 4;
     static constexpr size_t alignment = 16;
+
+#if defined(__SSE__)
+    static __m128 load(const float* p) { return _mm_load_ps(p); }
+    static void store(float* p, __m128 a) { _mm_store_ps(p, a); }
+    static __m128 set1(float f) { return _mm_set1_ps(f); }
+    static __m128 zero() { return _mm_setzero_ps(); }
+    static __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+    static __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+    static __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+    static __m128 mul_add(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); } // a * b + c
+    static __m128 div(__m128 a, __m128 b) { return _mm_div_ps(a, b); }
+    static __m128 sqrt(__m128 a) { return _mm_sqrt_ps(a); }
+    static __m128 rsqrt(__m128 a) { return _mm_rsqrt_ps(a); } // <- estimate, relative error up to 1.5 * 2^-12
+    static __m128 max(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+    static float reduce_max(__m128 a)
+    {
+        a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+        a = _mm_max_ss(a, _mm_shuffle_ps(a, a, 1));
+        return _mm_cvtss_f32(a);
+    }
+    static __m128 gather(const float* base, const int32_t* index) // <- no gather instruction before avx2
+    {
+        return _mm_setr_ps(base[index[0]], base[index[1]], base[index[2]], base[index[3]]);
+    }
+#endif
 };
 
 template <>
@@ -19,6 +75,36 @@ struct SIMD<__m256>
 {
     static constexpr size_t width = 8;
     static constexpr size_t alignment = 32;
+
+#if defined(__AVX2__)
+    static __m256 load(const float* p) { return _mm256_load_ps(p); }
+    static void store(float* p, __m256 a) { _mm256_store_ps(p, a); }
+    static __m256 set1(float f) { return _mm256_set1_ps(f); }
+    static __m256 zero() { return _mm256_setzero_ps(); }
+    static __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+    static __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+    static __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+    static __m256 mul_add(__m256 a, __m256 b, __m256 c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    static __m256 mul_add(__m256 a, __m256 b, __m256 c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+    static __m256 div(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+    static __m256 sqrt(__m256 a) { return _mm256_sqrt_ps(a); }
+    static __m256 rsqrt(__m256 a) { return _mm256_rsqrt_ps(a); } // <- estimate, relative error up to 1.5 * 2^-12
+    static __m256 max(__m256 a, __m256 b) { return _mm256_max_ps(a, b); }
+    static float reduce_max(__m256 a)
+    {
+        __m128 b = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)); // <- not through SIMD<__m128>, see below
+        b = _mm_max_ps(b, _mm_movehl_ps(b, b));
+        b = _mm_max_ss(b, _mm_shuffle_ps(b, b, 1));
+        return _mm_cvtss_f32(b);
+    }
+    static __m256 gather(const float* base, const int32_t* index)
+    {
+        return _mm256_i32gather_ps(base, _mm256_load_si256(reinterpret_cast<const __m256i*>(index)), 4);
+    }
+#endif
 };
 
 template <>
@@ -26,6 +112,23 @@ struct SIMD<__m512>
 {
     static constexpr size_t width = 16;
     static constexpr size_t alignment = 64;
+
+#if defined(__AVX512F__)
+    static __m512 load(const float* p) { return _mm512_load_ps(p); }
+    static void store(float* p, __m512 a) { _mm512_store_ps(p, a); }
+    static __m512 set1(float f) { return _mm512_set1_ps(f); }
+    static __m512 zero() { return _mm512_setzero_ps(); }
+    static __m512 add(__m512 a, __m512 b) { return _mm512_add_ps(a, b); }
+    static __m512 sub(__m512 a, __m512 b) { return _mm512_sub_ps(a, b); }
+    static __m512 mul(__m512 a, __m512 b) { return _mm512_mul_ps(a, b); }
+    static __m512 mul_add(__m512 a, __m512 b, __m512 c) { return _mm512_fmadd_ps(a, b, c); }
+    static __m512 div(__m512 a, __m512 b) { return _mm512_div_ps(a, b); }
+    static __m512 sqrt(__m512 a) { return _mm512_sqrt_ps(a); }
+    static __m512 rsqrt(__m512 a) { return _mm512_rsqrt14_ps(a); } // <- estimate, relative error up to 2^-14
+    static __m512 max(__m512 a, __m512 b) { return _mm512_max_ps(a, b); }
+    static float reduce_max(__m512 a) { return _mm512_reduce_max_ps(a); }
+    static __m512 gather(const float* base, const int32_t* index) { return _mm512_i32gather_ps(_mm512_load_si512(index), base, 4); }
+#endif
 };
 
 enum class SIMD_TYPE
@@ -40,15 +143,57 @@ constexpr SIMD_TYPE get_simd_type()
 {
 #if defined(__AVX512F__)
     return SIMD_TYPE::SIMD_512;
-#else if defined(__AVX2__)
+#elif defined(__AVX2__)
     return SIMD_TYPE::SIMD_256;
-#else if defined(__AVX__)
+#elif defined(__SSE__)
     return SIMD_TYPE::SIMD_128;
 #else
     return SIMD_TYPE::NONE;
 #endif
 }
 
+// Widest register type enabled by the compiler flags (e.g. -mavx2 or -march=native).
+using SIMD_NATIVE = std::conditional_t<get_simd_type() == SIMD_TYPE::SIMD_512, __m512,
+                    std::conditional_t<get_simd_type() == SIMD_TYPE::SIMD_256, __m256, __m128>>;
+
+// Runtime dispatch
+// The hot kernels are compiled once per instruction set, each in its own translation unit built with the matching
+// flags (see meson.build), and the widest one the CPU supports is picked when they are called. So that a kernel
+// compiled for AVX-512 can never end up in the SSE path through an inline function merged at link time, a kernel
+// translation unit only ever uses the SIMD<> operations of its own register type.
+SIMD_TYPE get_cpu_simd_type();                   // widest instruction set the CPU and the OS support
+SIMD_TYPE get_runtime_simd_type();               // instruction set the dispatched kernels currently use
+SIMD_TYPE set_runtime_simd_type(SIMD_TYPE type); // clamped to get_cpu_simd_type(), returns the type actually set
+const char* to_string(SIMD_TYPE type);
+
+// Kernel table `Table` compiled for RegisterType. Each table declares its four specializations under its definition,
+// they are defined per instruction set all tables together: sources/kernels.cpp for float and __m128 with the default
+// flags, sources/kernels_avx2.cpp and sources/kernels_avx512.cpp for the wider registers.
+template <typename Table, typename RegisterType>
+const Table& kernels_for();
+
+// Table of the instruction set the dispatched kernels currently use.
+template <typename Table>
+const Table& select_kernels()
+{
+    switch (get_runtime_simd_type())
+    {
+        case SIMD_TYPE::SIMD_512: return kernels_for<Table, __m512>();
+        case SIMD_TYPE::SIMD_256: return kernels_for<Table, __m256>();
+        case SIMD_TYPE::SIMD_128: return kernels_for<Table, __m128>();
+        default:                  return kernels_for<Table, float>();
+    }
+}
+
+// Arrays shared between threads are aligned on cache lines so that ranges split on cache line boundaries never share
+// a line with their neighbours.
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Arrays handed to the dispatched kernels are padded to a whole number of the widest register and aligned for it,
+// so that any of the kernels can process them without a scalar tail.
+constexpr size_t SIMD_MAX_WIDTH = SIMD<__m512>::width;
+constexpr size_t SIMD_MAX_ALIGNMENT = SIMD<__m512>::alignment;
+
 template <typename T>
 using aligned_unique_ptr = std::unique_ptr<T, decltype(&std::free)>;
 
@@ -77,4 +222,3 @@ auto make_aligned_unique(size_t count, size_t alignment)
         return aligned_unique_ptr<T>(static_cast<T*>(ptr), std::free);
     }
 }
-
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "common.h"
+#include "vector.h"
+#include "macro.h"
+
+#include <immintrin.h>
+
+namespace math
+{
+    // 3D vector held in an SSE register (x, y, z, 0), every operation inline. Meant for the per-triangle and per-edge
+    // solver math: load the vec3 once, work on vec3a, convert back when storing. The sums are carried out in the same
+    // order as in vec3, so both types give the same results.
+    struct alignas(16) vec3a
+    {
+        __m128 v;
+
+        vec3a()
+            : v{ _mm_setzero_ps() }
+        { }
+
+        vec3a(float x, float y, float z)
+            : v{ _mm_set_ps(0.f, z, y, x) }
+        { }
+
+        explicit vec3a(__m128 r)
+            : v{ r }
+        { }
+
+        explicit vec3a(const vec3& u)
+            : v{ _mm_set_ps(0.f, u.z, u.y, u.x) }
+        { }
+
+        vec3 to_vec3() const
+        {
+            alignas(16) float f[4];
+            _mm_store_ps(f, v);
+            return { f[0], f[1], f[2] };
+        }
+
+        float x() const { return _mm_cvtss_f32(v); }
+        float y() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))); }
+        float z() const { return _mm_cvtss_f32(_mm_movehl_ps(v, v)); }
+
+        vec3a operator+(const vec3a& u) const { return vec3a(_mm_add_ps(v, u.v)); }
+        vec3a operator-(const vec3a& u) const { return vec3a(_mm_sub_ps(v, u.v)); }
+        vec3a operator-() const { return vec3a(_mm_sub_ps(_mm_setzero_ps(), v)); }
+        vec3a operator*(float scalar) const { return vec3a(_mm_mul_ps(v, _mm_set1_ps(scalar))); }
+        vec3a operator/(float scalar) const { return vec3a(_mm_div_ps(v, _mm_set1_ps(scalar))); }
+
+        vec3a& operator+=(const vec3a& u) { v = _mm_add_ps(v, u.v); return *this; }
+        vec3a& operator-=(const vec3a& u) { v = _mm_sub_ps(v, u.v); return *this; }
+        vec3a& operator*=(float scalar) { v = _mm_mul_ps(v, _mm_set1_ps(scalar)); return *this; }
+
+        // x * x + y * y + z * z in every lane
+        static __m128 dot_splat(__m128 a, __m128 b)
+        {
+            const __m128 m = _mm_mul_ps(a, b);
+            const __m128 xy = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+            const __m128 xyz = _mm_add_ss(xy, _mm_movehl_ps(m, m));
+            return _mm_shuffle_ps(xyz, xyz, _MM_SHUFFLE(0, 0, 0, 0));
+        }
+
+        static float dot(const vec3a& a, const vec3a& b)
+        {
+            return _mm_cvtss_f32(dot_splat(a.v, b.v));
+        }
+
+        static vec3a cross(const vec3a& a, const vec3a& b)
+        {
+            const __m128 a_yzx = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 0, 2, 1));
+            const __m128 b_yzx = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 0, 2, 1));
+            const __m128 a_zxy = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 1, 0, 2));
+            const __m128 b_zxy = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 1, 0, 2));
+            return vec3a(_mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(b_yzx, a_zxy)));
+        }
+
+        float unsqrt_length() const
+        {
+            return dot(*this, *this);
+        }
+
+        float length() const
+        {
+            return _mm_cvtss_f32(_mm_sqrt_ss(dot_splat(v, v)));
+        }
+
+        vec3a normalized() const
+        {
+            const __m128 length = _mm_sqrt_ps(dot_splat(v, v));
+            DBG_ASSERT(_mm_cvtss_f32(length) != 0.f);
+            return vec3a(_mm_div_ps(v, length));
+        }
+
+        // rsqrt estimate refined by one Newton step (see NormalizeMode), 1 / sqrt(d) in every lane
+        static __m128 rsqrt_splat(__m128 d)
+        {
+            const __m128 y = _mm_rsqrt_ps(d);
+            return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(.5f), y), _mm_sub_ps(_mm_set1_ps(3.f), _mm_mul_ps(_mm_mul_ps(d, y), y)));
+        }
+
+        float fast_length() const
+        {
+            const __m128 d = dot_splat(v, v);
+            return _mm_cvtss_f32(_mm_mul_ss(d, rsqrt_splat(_mm_max_ps(d, _mm_set1_ps(1e-30f))))); // <- a zero vector has a zero length
+        }
+
+        vec3a fast_normalized() const
+        {
+            const __m128 d = _mm_max_ps(dot_splat(v, v), _mm_set1_ps(1e-30f)); // <- a zero vector stays zero
+            return vec3a(_mm_mul_ps(v, rsqrt_splat(d)));
+        }
+
+        float length(NormalizeMode mode) const { return mode == NormalizeMode::FAST ? fast_length() : length(); }
+        vec3a normalized(NormalizeMode mode) const { return mode == NormalizeMode::FAST ? fast_normalized() : normalized(); }
+    };
+
+    inline vec3a operator*(float scalar, const vec3a& u)
+    {
+        return u * scalar;
+    }
+}
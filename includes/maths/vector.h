@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <memory>
 
 #include "common.h"
@@ -7,6 +8,18 @@
 
 namespace math
 {
+    // EXACT: sqrt and divide. FAST: rsqrt estimate refined by one Newton step, relative error under 5e-7 on lengths and
+    // normalized vectors. The solvers and the batch operations below follow get_normalize_mode(), set once from the
+    // config at startup. Zero vectors normalize to zero in FAST mode.
+    enum class NormalizeMode
+    {
+        EXACT,
+        FAST
+    };
+
+    void set_normalize_mode(NormalizeMode mode);
+    NormalizeMode get_normalize_mode();
+
     struct vec3
     {
         vec3();
@@ -29,6 +42,11 @@ namespace math
         float unsqrt_length() const;
         vec3 normalized() const;
 
+        float fast_length() const;
+        vec3 fast_normalized() const;
+        float length(NormalizeMode mode) const { return mode == NormalizeMode::FAST ? fast_length() : length(); }
+        vec3 normalized(NormalizeMode mode) const { return mode == NormalizeMode::FAST ? fast_normalized() : normalized(); }
+
         static float dot(const vec3& v1, const vec3& v2);
         static vec3 cross(const vec3& v1, const vec3& v2);
 
@@ -42,13 +60,12 @@ namespace math
     extern vec3 operator*(const float scalar, const vec3& v);
 
 
-    template <typename RegisterType>
+    // Structure of arrays of 3D vectors, one array per axis. The arrays are padded and aligned for the widest
+    // register so that the operations below can run with whichever kernel the CPU supports (see maths/simd.h). The
+    // padding lanes are zero and stay finite through every operation.
     class Vec3D_simd
     {
     private:
-        constexpr static size_t width     = SIMD<RegisterType>::width;
-        constexpr static size_t alignment = SIMD<RegisterType>::alignment;
-
         aligned_unique_ptr<float[]> _x{ nullptr, std::free };
         aligned_unique_ptr<float[]> _y{ nullptr, std::free };
         aligned_unique_ptr<float[]> _z{ nullptr, std::free };
@@ -60,108 +77,72 @@ namespace math
         { }
 
         explicit Vec3D_simd(size_t count)
-            : _x{ make_aligned_unique<float[]>(count, alignment) }
-            , _y{ make_aligned_unique<float[]>(count, alignment) }
-            , _z{ make_aligned_unique<float[]>(count, alignment) }
-            , _count{ ((count + width - 1) / width) * width } // round to ceiling width
-        { }
+            : _count{ ((count + SIMD_MAX_WIDTH - 1) / SIMD_MAX_WIDTH) * SIMD_MAX_WIDTH } // round to ceiling width
+        {
+            _x = make_aligned_unique<float[]>(_count, SIMD_MAX_ALIGNMENT);
+            _y = make_aligned_unique<float[]>(_count, SIMD_MAX_ALIGNMENT);
+            _z = make_aligned_unique<float[]>(_count, SIMD_MAX_ALIGNMENT);
+            std::fill(_x.get(), _x.get() + _count, 0.f);
+            std::fill(_y.get(), _y.get() + _count, 0.f);
+            std::fill(_z.get(), _z.get() + _count, 0.f);
+        }
 
         float & x(size_t index) const
         {
-            return x[index];
+            return _x[index];
         }
 
         float & y(size_t index) const
         {
-            return x[index];
+            return _y[index];
         }
 
         float & z(size_t index) const
         {
-            return x[index];
+            return _z[index];
         }
 
-        size_t size() const
+        float * x_data() const
         {
-            return _count;
+            return _x.get();
         }
-    };
 
-    template <typename RegisterType>
-    void add_3D_vectors_simd(const Vec3D_simd<RegisterType> & a, const Vec3D_simd<RegisterType> & b, Vec3D_simd<RegisterType> & result);
-
-    template <>
-    void add_3D_vectors_simd<__m128>(const Vec3D_simd<__m128> & a, const Vec3D_simd<__m128> & b, Vec3D_simd<__m128> & result)
-    {
-        constexpr auto width = SIMD<__m128>::width;
-        const auto count = std::min(a.size(), b.size(), result.size());
-        for (auto i = 0u; i < count; i += width)
+        float * y_data() const
         {
-            __m128 ax = _mm_load_ps(&a.x(i));
-            __m128 ay = _mm_load_ps(&a.y(i));
-            __m128 az = _mm_load_ps(&a.z(i));
-
-            __m128 bx = _mm_load_ps(&b.x(i));
-            __m128 by = _mm_load_ps(&b.y(i));
-            __m128 bz = _mm_load_ps(&b.z(i));
-
-            __m128 rx = _mm_add_ps(ax, bx);
-            __m128 ry = _mm_add_ps(ay, by);
-            __m128 rz = _mm_add_ps(az, bz);
-
-            _mm_store_ps(&result.x(i), rx);
-            _mm_store_ps(&result.y(i), ry);
-            _mm_store_ps(&result.z(i), rz);
+            return _y.get();
         }
-    }
 
-    template <>
-    void add_3D_vectors_simd<__m256>(const Vec3D_simd<__m256> & a, const Vec3D_simd<__m256> & b, Vec3D_simd<__m256> & result)
-    {
-        constexpr auto width = SIMD<__m256>::width;
-        const auto count = std::min(a.size(), b.size(), result.size());
-        for (auto i = 0u; i < count; i += width)
+        float * z_data() const
         {
-            __m256 ax = _mm256_load_ps(&a.x(i));
-            __m256 ay = _mm256_load_ps(&a.y(i));
-            __m256 az = _mm256_load_ps(&a.z(i));
-
-            __m256 bx = _mm256_load_ps(&b.x(i));
-            __m256 by = _mm256_load_ps(&b.y(i));
-            __m256 bz = _mm256_load_ps(&b.z(i));
-
-            __m256 rx = _mm256_add_ps(ax, bx);
-            __m256 ry = _mm256_add_ps(ay, by);
-            __m256 rz = _mm256_add_ps(az, bz);
-
-            _mm256_store_ps(&result.x(i), rx);
-            _mm256_store_ps(&result.y(i), ry);
-            _mm256_store_ps(&result.z(i), rz);
+            return _z.get();
         }
-    }
 
-    template <>
-    void add_3D_vectors_simd<__m512>(const Vec3D_simd<__m512> & a, const Vec3D_simd<__m512> & b, Vec3D_simd<__m512> & result)
-    {
-        constexpr auto width = SIMD<__m512>::width;
-        const auto count = std::min(a.size(), b.size(), result.size());
-        for (auto i = 0u; i < count; i += width)
+        vec3 get(size_t index) const
         {
-            __m512 ax = _mm512_load_ps(&a.x(i));
-            __m512 ay = _mm512_load_ps(&a.y(i));
-            __m512 az = _mm512_load_ps(&a.z(i));
-
-            __m512 bx = _mm512_load_ps(&b.x(i));
-            __m512 by = _mm512_load_ps(&b.y(i));
-            __m512 bz = _mm512_load_ps(&b.z(i));
+            return { _x[index], _y[index], _z[index] };
+        }
 
-            __m512 rx = _mm512_add_ps(ax, bx);
-            __m512 ry = _mm512_add_ps(ay, by);
-            __m512 rz = _mm512_add_ps(az, bz);
+        void set(size_t index, const vec3 & v)
+        {
+            _x[index] = v.x;
+            _y[index] = v.y;
+            _z[index] = v.z;
+        }
 
-            _mm512_store_ps(&result.x(i), rx);
-            _mm512_store_ps(&result.y(i), ry);
-            _mm512_store_ps(&result.z(i), rz);
+        size_t size() const
+        {
+            return _count;
         }
-    }
+    };
+
+    // Lane-wise operations, over the lanes the arguments have in common. The result may be one of the inputs.
+    void add_3D_vectors_simd(const Vec3D_simd & a, const Vec3D_simd & b, Vec3D_simd & result);                  // a + b
+    void sub_3D_vectors_simd(const Vec3D_simd & a, const Vec3D_simd & b, Vec3D_simd & result);                  // a - b
+    void scale_3D_vectors_simd(const Vec3D_simd & a, float scalar, Vec3D_simd & result);                        // a * s
+    void mul_add_3D_vectors_simd(const Vec3D_simd & a, float scalar, const Vec3D_simd & b, Vec3D_simd & result); // a * s + b
+    void cross_3D_vectors_simd(const Vec3D_simd & a, const Vec3D_simd & b, Vec3D_simd & result);
+    void normalize_3D_vectors_simd(const Vec3D_simd & a, Vec3D_simd & result); // zero vectors stay zero, get_normalize_mode()
+    // `result` holds at least min(a.size(), b.size()) floats aligned on SIMD_MAX_ALIGNMENT
+    void dot_3D_vectors_simd(const Vec3D_simd & a, const Vec3D_simd & b, float * result);
+    void length_3D_vectors_simd(const Vec3D_simd & a, float * result); // get_normalize_mode()
 }
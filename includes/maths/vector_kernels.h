@@ -0,0 +1,207 @@
+#pragma once
+
+#include "simd.h"
+
+// Kernels behind the Vec3D_simd operations of vector.h, compiled once per instruction set and picked at runtime with
+// select_kernels<math::Vec3DKernels>(). Counts are multiples of SIMD_MAX_WIDTH and the arrays are aligned on SIMD_MAX_ALIGNMENT, so
+// that every kernel works on whole registers.
+namespace math
+{
+    struct Vec3D_lanes
+    {
+        float* x;
+        float* y;
+        float* z;
+    };
+
+    struct Vec3DKernels
+    {
+        void (*add)(Vec3D_lanes a, Vec3D_lanes b, Vec3D_lanes result, size_t count);
+        void (*sub)(Vec3D_lanes a, Vec3D_lanes b, Vec3D_lanes result, size_t count);
+        void (*scale)(Vec3D_lanes a, float scalar, Vec3D_lanes result, size_t count);
+        void (*mul_add)(Vec3D_lanes a, float scalar, Vec3D_lanes b, Vec3D_lanes result, size_t count);
+        void (*dot)(Vec3D_lanes a, Vec3D_lanes b, float* result, size_t count);
+        void (*cross)(Vec3D_lanes a, Vec3D_lanes b, Vec3D_lanes result, size_t count);
+        void (*normalize)(Vec3D_lanes a, Vec3D_lanes result, size_t count);
+        void (*fast_normalize)(Vec3D_lanes a, Vec3D_lanes result, size_t count);
+        void (*length)(Vec3D_lanes a, float* result, size_t count);
+        void (*fast_length)(Vec3D_lanes a, float* result, size_t count);
+    };
+
+    namespace vec3d_kernels
+    {
+        template <typename RegisterType>
+        void add(Vec3D_lanes a, Vec3D_lanes b, Vec3D_lanes result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                S::store(result.x + n, S::add(S::load(a.x + n), S::load(b.x + n)));
+                S::store(result.y + n, S::add(S::load(a.y + n), S::load(b.y + n)));
+                S::store(result.z + n, S::add(S::load(a.z + n), S::load(b.z + n)));
+            }
+        }
+
+        template <typename RegisterType>
+        void sub(Vec3D_lanes a, Vec3D_lanes b, Vec3D_lanes result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                S::store(result.x + n, S::sub(S::load(a.x + n), S::load(b.x + n)));
+                S::store(result.y + n, S::sub(S::load(a.y + n), S::load(b.y + n)));
+                S::store(result.z + n, S::sub(S::load(a.z + n), S::load(b.z + n)));
+            }
+        }
+
+        template <typename RegisterType>
+        void scale(Vec3D_lanes a, float scalar, Vec3D_lanes result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            const RegisterType s = S::set1(scalar);
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                S::store(result.x + n, S::mul(S::load(a.x + n), s));
+                S::store(result.y + n, S::mul(S::load(a.y + n), s));
+                S::store(result.z + n, S::mul(S::load(a.z + n), s));
+            }
+        }
+
+        template <typename RegisterType>
+        void mul_add(Vec3D_lanes a, float scalar, Vec3D_lanes b, Vec3D_lanes result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            const RegisterType s = S::set1(scalar);
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                S::store(result.x + n, S::mul_add(S::load(a.x + n), s, S::load(b.x + n)));
+                S::store(result.y + n, S::mul_add(S::load(a.y + n), s, S::load(b.y + n)));
+                S::store(result.z + n, S::mul_add(S::load(a.z + n), s, S::load(b.z + n)));
+            }
+        }
+
+        template <typename RegisterType>
+        void dot(Vec3D_lanes a, Vec3D_lanes b, float* result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                RegisterType d = S::mul(S::load(a.x + n), S::load(b.x + n));
+                d = S::mul_add(S::load(a.y + n), S::load(b.y + n), d);
+                d = S::mul_add(S::load(a.z + n), S::load(b.z + n), d);
+                S::store(result + n, d);
+            }
+        }
+
+        template <typename RegisterType>
+        void cross(Vec3D_lanes a, Vec3D_lanes b, Vec3D_lanes result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                const RegisterType ax = S::load(a.x + n);
+                const RegisterType ay = S::load(a.y + n);
+                const RegisterType az = S::load(a.z + n);
+                const RegisterType bx = S::load(b.x + n);
+                const RegisterType by = S::load(b.y + n);
+                const RegisterType bz = S::load(b.z + n);
+                S::store(result.x + n, S::sub(S::mul(ay, bz), S::mul(by, az)));
+                S::store(result.y + n, S::sub(S::mul(az, bx), S::mul(bz, ax)));
+                S::store(result.z + n, S::sub(S::mul(ax, by), S::mul(bx, ay)));
+            }
+        }
+
+        template <typename RegisterType>
+        void normalize(Vec3D_lanes a, Vec3D_lanes result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            const RegisterType smallest = S::set1(1e-30f); // <- 0 / sqrt(smallest) keeps zero vectors at zero
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                const RegisterType x = S::load(a.x + n);
+                const RegisterType y = S::load(a.y + n);
+                const RegisterType z = S::load(a.z + n);
+                const RegisterType length = S::sqrt(S::max(S::mul_add(z, z, S::mul_add(y, y, S::mul(x, x))), smallest));
+                S::store(result.x + n, S::div(x, length));
+                S::store(result.y + n, S::div(y, length));
+                S::store(result.z + n, S::div(z, length));
+            }
+        }
+
+        // rsqrt estimate refined by one Newton step: y * (3 - d * y * y) / 2
+        template <typename RegisterType>
+        RegisterType rsqrt_newton(RegisterType d)
+        {
+            using S = SIMD<RegisterType>;
+            const RegisterType y = S::rsqrt(d);
+            return S::mul(S::mul(S::set1(.5f), y), S::sub(S::set1(3.f), S::mul(S::mul(d, y), y)));
+        }
+
+        template <typename RegisterType>
+        void fast_normalize(Vec3D_lanes a, Vec3D_lanes result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            const RegisterType smallest = S::set1(1e-30f);
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                const RegisterType x = S::load(a.x + n);
+                const RegisterType y = S::load(a.y + n);
+                const RegisterType z = S::load(a.z + n);
+                const RegisterType invLength = rsqrt_newton<RegisterType>(S::max(S::mul_add(z, z, S::mul_add(y, y, S::mul(x, x))), smallest));
+                S::store(result.x + n, S::mul(x, invLength));
+                S::store(result.y + n, S::mul(y, invLength));
+                S::store(result.z + n, S::mul(z, invLength));
+            }
+        }
+
+        template <typename RegisterType>
+        void length(Vec3D_lanes a, float* result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                const RegisterType x = S::load(a.x + n);
+                const RegisterType y = S::load(a.y + n);
+                const RegisterType z = S::load(a.z + n);
+                S::store(result + n, S::sqrt(S::mul_add(z, z, S::mul_add(y, y, S::mul(x, x)))));
+            }
+        }
+
+        template <typename RegisterType>
+        void fast_length(Vec3D_lanes a, float* result, size_t count)
+        {
+            using S = SIMD<RegisterType>;
+            const RegisterType smallest = S::set1(1e-30f);
+            for (size_t n = 0; n < count; n += S::width)
+            {
+                const RegisterType x = S::load(a.x + n);
+                const RegisterType y = S::load(a.y + n);
+                const RegisterType z = S::load(a.z + n);
+                const RegisterType d = S::mul_add(z, z, S::mul_add(y, y, S::mul(x, x)));
+                S::store(result + n, S::mul(d, rsqrt_newton<RegisterType>(S::max(d, smallest))));
+            }
+        }
+
+        template <typename RegisterType>
+        constexpr Vec3DKernels make()
+        {
+            return {
+                &add<RegisterType>,
+                &sub<RegisterType>,
+                &scale<RegisterType>,
+                &mul_add<RegisterType>,
+                &dot<RegisterType>,
+                &cross<RegisterType>,
+                &normalize<RegisterType>,
+                &fast_normalize<RegisterType>,
+                &length<RegisterType>,
+                &fast_length<RegisterType>
+            };
+        }
+    }
+}
+
+template <> const math::Vec3DKernels& kernels_for<math::Vec3DKernels, float>();
+template <> const math::Vec3DKernels& kernels_for<math::Vec3DKernels, __m128>();
+template <> const math::Vec3DKernels& kernels_for<math::Vec3DKernels, __m256>();
+template <> const math::Vec3DKernels& kernels_for<math::Vec3DKernels, __m512>();
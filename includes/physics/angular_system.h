@@ -4,6 +4,9 @@
 #include <memory>
 
 #include "maths/math.h"
+#include "physics/slot_allocator.h"
+
+using AngularHandle = SlotHandle;
 
 struct AngularData
 {
@@ -18,19 +21,20 @@ class AngularMotionSystem
 public:
     explicit AngularMotionSystem(size_t size_angular_data_pool);
 
-    size_t new_angular_data(const math::quat& position, const math::quat& velocity, const math::mat& inertiaMatrix);
-    void free_angular_data(size_t i);
-    void stop_angular_update(size_t i);
-    void resume_angular_update(size_t i);
-    math::quat get_angular_position(size_t i);
-    void add_torque(size_t i, const math::vec3& torque);
-    void set_inertia_matrix(size_t i, const math::mat& inertiaMatrix);
+    AngularHandle new_angular_data(const math::quat& position, const math::quat& velocity, const math::mat& inertiaMatrix);
+    void free_angular_data(AngularHandle h);
+    void stop_angular_update(AngularHandle h);
+    void resume_angular_update(AngularHandle h);
+    [[nodiscard]] bool is_valid(AngularHandle h) const;
+    math::quat get_angular_position(AngularHandle h);
+    void add_torque(AngularHandle h, const math::vec3& torque);
+    void set_inertia_matrix(AngularHandle h, const math::mat& inertiaMatrix);
     void update_data();
     [[nodiscard]] bool wrong_init() const;
 
 private:
     size_t                         size;
-    size_t                         firstAvailable;
+    SlotAllocator                  slots;
     std::unique_ptr<AngularData[]> angularDataPool;
     std::unique_ptr<bool[]>        angularDataUsed;
     std::unique_ptr<bool[]>        angularDataSkip;
@@ -1,18 +1,34 @@
 #pragma once
 
+// default step, the step actually taken is a runtime value passed to the solvers
 #ifndef PHYSICS_TIME_STEP
     #define PHYSICS_TIME_STEP 0.0005f
-    #define INV_PHYSICS_TIME_STEP (1.f / PHYSICS_TIME_STEP)
 #endif
 
 #ifndef LIMIT_COLLISION_PUSH_APART_FACTOR
     #define LIMIT_COLLISION_PUSH_APART_FACTOR 1.f
 #endif
 
+// velocity kept after PHYSICS_TIME_STEP seconds, rescaled for other steps
 #ifndef PHYSICS_DAMPING_FACTOR
     #define PHYSICS_DAMPING_FACTOR .95f
 #endif
 
+// integrators::SemiImplicitEuler, integrators::StormerVerlet or integrators::PositionBased (physics/integrators.h)
+#ifndef PHYSICS_INTEGRATOR
+    #define PHYSICS_INTEGRATOR integrators::SemiImplicitEuler
+#endif
+
+// a cloth whose particles moved on average slower than PHYSICS_SLEEP_SPEED (m/s) over the last PHYSICS_SLEEP_DELAY
+// seconds falls asleep
+#ifndef PHYSICS_SLEEP_SPEED
+    #define PHYSICS_SLEEP_SPEED .01f
+#endif
+
+#ifndef PHYSICS_SLEEP_DELAY
+    #define PHYSICS_SLEEP_DELAY .5f
+#endif
+
 #ifndef FLOATING_ERROR_COUNTERING
     #define FLOATING_ERROR_COUNTERING .0000001f
 #endif
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "maths/simd.h"
+#include "maths/vector_kernels.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Edge distance kernel of Cloth, compiled once per instruction set like the triangle kernel (see
+// physics/triangle_kernels.h) and picked at runtime with select_kernels<EdgeKernels>().
+
+// SIZE edges per packet, one lane per edge, laid out like TrianglePacket. Everything but the positions is computed
+// once: rest length, share of the correction of each end and stiffness. The padding lanes repeat the first edge of
+// the packet with a zero weight.
+struct alignas(SIMD_MAX_ALIGNMENT) EdgePacket
+{
+    static constexpr size_t SIZE = SIMD_MAX_WIDTH;
+
+    int32_t  position[2][SIZE]; // <- of each end, index of its x in the positions array (3 floats per point)
+    uint32_t edge[SIZE];        // <- index in Cloth::edges
+    float    restLength[SIZE];
+    float    weight[2][SIZE];   // <- inverse mass of the end over the sum of both, over the number of edges of the end
+    float    stiffness[SIZE];
+    float    invMass[2][SIZE];      // <- XPBD only, from here
+    float    invNbrEdges[2][SIZE];  // <- 1 / number of edges of the end, 0 in the padding lanes
+    float    compliance[SIZE];
+    uint32_t lanes;             // <- lanes holding an edge, the first ones
+};
+
+// Offset of both ends of every edge of a packet, nothing is applied by the kernel.
+struct alignas(SIMD_MAX_ALIGNMENT) EdgeOffsets
+{
+    float x[2][EdgePacket::SIZE];
+    float y[2][EdgePacket::SIZE];
+    float z[2][EdgePacket::SIZE];
+};
+
+// Lagrange multiplier of every edge of a packet, XPBD only. Zeroed at the start of every step.
+struct alignas(SIMD_MAX_ALIGNMENT) EdgeLambdas
+{
+    float value[EdgePacket::SIZE];
+};
+
+struct EdgeKernels
+{
+    // Brings the ends of the edges of the packets [0, count) back toward their rest length, from `positions`. The
+    // length follows NormalizeMode::EXACT or NormalizeMode::FAST.
+    void (*distance)(const EdgePacket* packets, size_t count, const float* positions, EdgeOffsets* offsets);
+    void (*fast_distance)(const EdgePacket* packets, size_t count, const float* positions, EdgeOffsets* offsets);
+    // Same with compliant constraints, the compliance of each edge being divided by dt^2. `average` scales the offsets
+    // by invNbrEdges, for Jacobi.
+    void (*xpbd_distance)(const EdgePacket* packets, size_t count, const float* positions, float invDt2, bool average,
+                          EdgeLambdas* lambdas, EdgeOffsets* offsets);
+    void (*fast_xpbd_distance)(const EdgePacket* packets, size_t count, const float* positions, float invDt2, bool average,
+                               EdgeLambdas* lambdas, EdgeOffsets* offsets);
+};
+
+template <> const EdgeKernels& kernels_for<EdgeKernels, float>();
+template <> const EdgeKernels& kernels_for<EdgeKernels, __m128>();
+template <> const EdgeKernels& kernels_for<EdgeKernels, __m256>();
+template <> const EdgeKernels& kernels_for<EdgeKernels, __m512>();
+
+namespace edge_kernels
+{
+    template <typename RegisterType, bool Fast>
+    void distance(const EdgePacket* packets, size_t count, const float* positions, EdgeOffsets* offsets)
+    {
+        using S = SIMD<RegisterType>;
+        const RegisterType smallest = S::set1(1e-30f); // <- a collapsed edge gets no direction, and no offset
+        for (size_t p = 0; p < count; p++)
+        {
+            const EdgePacket& packet = packets[p];
+            EdgeOffsets& out = offsets[p];
+            for (size_t n = 0; n < EdgePacket::SIZE; n += S::width)
+            {
+                const int32_t* a = packet.position[0] + n;
+                const int32_t* b = packet.position[1] + n;
+                const RegisterType dx = S::sub(S::gather(positions, b), S::gather(positions, a));
+                const RegisterType dy = S::sub(S::gather(positions + 1, b), S::gather(positions + 1, a));
+                const RegisterType dz = S::sub(S::gather(positions + 2, b), S::gather(positions + 2, a));
+                const RegisterType length2 = S::max(S::mul_add(dz, dz, S::mul_add(dy, dy, S::mul(dx, dx))), smallest);
+
+                // (length - rest) / length, the share of the stretch each end takes back along the edge
+                RegisterType stretch;
+                if constexpr (Fast)
+                {
+                    const RegisterType invLength = math::vec3d_kernels::rsqrt_newton<RegisterType>(length2);
+                    stretch = S::sub(S::set1(1.f), S::mul(S::load(packet.restLength + n), invLength));
+                }
+                else
+                {
+                    const RegisterType length = S::sqrt(length2);
+                    stretch = S::div(S::sub(length, S::load(packet.restLength + n)), length);
+                }
+                stretch = S::mul(stretch, S::load(packet.stiffness + n));
+
+                const RegisterType first = S::mul(stretch, S::load(packet.weight[0] + n));
+                const RegisterType second = S::sub(S::zero(), S::mul(stretch, S::load(packet.weight[1] + n)));
+                S::store(out.x[0] + n, S::mul(dx, first));
+                S::store(out.y[0] + n, S::mul(dy, first));
+                S::store(out.z[0] + n, S::mul(dz, first));
+                S::store(out.x[1] + n, S::mul(dx, second));
+                S::store(out.y[1] + n, S::mul(dy, second));
+                S::store(out.z[1] + n, S::mul(dz, second));
+            }
+        }
+    }
+
+    // XPBD: C = length - rest along n = d / length, dlambda = (-C - alphaTilde * lambda) / (w0 + w1 + alphaTilde) and
+    // the ends move by -w0 * n * dlambda and w1 * n * dlambda.
+    template <typename RegisterType, bool Fast>
+    void xpbd_distance(const EdgePacket* packets, size_t count, const float* positions, float invDt2, bool average,
+                       EdgeLambdas* lambdas, EdgeOffsets* offsets)
+    {
+        using S = SIMD<RegisterType>;
+        const RegisterType smallest = S::set1(1e-30f);
+        const RegisterType scaling = S::set1(invDt2);
+        for (size_t p = 0; p < count; p++)
+        {
+            const EdgePacket& packet = packets[p];
+            EdgeOffsets& out = offsets[p];
+            float* lambda = lambdas[p].value;
+            for (size_t n = 0; n < EdgePacket::SIZE; n += S::width)
+            {
+                const int32_t* a = packet.position[0] + n;
+                const int32_t* b = packet.position[1] + n;
+                const RegisterType dx = S::sub(S::gather(positions, b), S::gather(positions, a));
+                const RegisterType dy = S::sub(S::gather(positions + 1, b), S::gather(positions + 1, a));
+                const RegisterType dz = S::sub(S::gather(positions + 2, b), S::gather(positions + 2, a));
+                const RegisterType length2 = S::max(S::mul_add(dz, dz, S::mul_add(dy, dy, S::mul(dx, dx))), smallest);
+
+                RegisterType length, invLength;
+                if constexpr (Fast)
+                {
+                    invLength = math::vec3d_kernels::rsqrt_newton<RegisterType>(length2);
+                    length = S::mul(length2, invLength);
+                }
+                else
+                {
+                    length = S::sqrt(length2);
+                    invLength = S::div(S::set1(1.f), length);
+                }
+
+                const RegisterType w0 = S::load(packet.invMass[0] + n);
+                const RegisterType w1 = S::load(packet.invMass[1] + n);
+                const RegisterType alpha = S::mul(S::load(packet.compliance + n), scaling);
+                const RegisterType last = S::load(lambda + n);
+                const RegisterType c = S::sub(length, S::load(packet.restLength + n));
+                const RegisterType delta = S::div(S::sub(S::zero(), S::mul_add(alpha, last, c)), S::add(S::add(w0, w1), alpha));
+                S::store(lambda + n, S::add(last, delta));
+
+                // d / length * dlambda, d going from the first end to the second
+                const RegisterType along = S::mul(delta, invLength);
+                RegisterType first = S::sub(S::zero(), S::mul(along, w0));
+                RegisterType second = S::mul(along, w1);
+                if (average)
+                {
+                    first = S::mul(first, S::load(packet.invNbrEdges[0] + n));
+                    second = S::mul(second, S::load(packet.invNbrEdges[1] + n));
+                }
+                S::store(out.x[0] + n, S::mul(dx, first));
+                S::store(out.y[0] + n, S::mul(dy, first));
+                S::store(out.z[0] + n, S::mul(dz, first));
+                S::store(out.x[1] + n, S::mul(dx, second));
+                S::store(out.y[1] + n, S::mul(dy, second));
+                S::store(out.z[1] + n, S::mul(dz, second));
+            }
+        }
+    }
+
+    template <typename RegisterType>
+    constexpr EdgeKernels make()
+    {
+        return {
+            &distance<RegisterType, false>,
+            &distance<RegisterType, true>,
+            &xpbd_distance<RegisterType, false>,
+            &xpbd_distance<RegisterType, true>
+        };
+    }
+}
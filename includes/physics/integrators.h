@@ -0,0 +1,87 @@
+#pragma once
+
+#include "maths/simd.h"
+
+// Integrator policies for LinearMotionSystem, selected at compile time with PHYSICS_INTEGRATOR (see constants.h).
+// A policy advances one register of lanes of one axis; it is written against the SIMD<> trait so that the same code
+// runs on full registers and, with SIMD<float>, on the particles left over.
+//
+// Policies that keep the previous position derive the velocity from the motion over the last step. To keep both
+// representations consistent, the motion system moves the previous position whenever a velocity is written directly
+// (impulses, add_velocity), so that (position - previous) / dt always equals the stored velocity.
+namespace integrators
+{
+    template <typename RegisterType>
+    struct StepConstants
+    {
+        using S = SIMD<RegisterType>;
+
+        // `previousDt` is the step that produced the previous positions, it differs from `dt` with a variable step
+        StepConstants(float dt, float previousDt, float damping)
+            : dt{ S::set1(dt) }
+            , dt2{ S::set1(dt * dt) }
+            , invDt{ S::set1(1.f / dt) }
+            , invPreviousDt{ S::set1(1.f / previousDt) }
+            , dtRatio{ S::set1(dt / previousDt) }
+            , damping{ S::set1(damping) }
+        { }
+
+        RegisterType dt;
+        RegisterType dt2;
+        RegisterType invDt;
+        RegisterType invPreviousDt;
+        RegisterType dtRatio;
+        RegisterType damping;
+    };
+
+    // v += f / m * dt, then p += v * dt. The reference integrator, it never reads nor writes the previous position.
+    struct SemiImplicitEuler
+    {
+        static constexpr bool keeps_previous_position = false;
+
+        template <typename RegisterType>
+        static void step(RegisterType& p, RegisterType& v, RegisterType& /* prev */, RegisterType f, RegisterType im,
+                         const StepConstants<RegisterType>& k)
+        {
+            using S = SIMD<RegisterType>;
+            v = S::mul_add(f, S::mul(im, k.dt), S::mul(v, k.damping));
+            p = S::mul_add(v, k.dt, p);
+        }
+    };
+
+    // Position form of Stormer-Verlet: p' = p + (p - prev) * damping * dt / previousDt + f / m * dt^2. The stored velocity is only an
+    // output, so that rounding in it never feeds back into the trajectory.
+    struct StormerVerlet
+    {
+        static constexpr bool keeps_previous_position = true;
+
+        template <typename RegisterType>
+        static void step(RegisterType& p, RegisterType& v, RegisterType& prev, RegisterType f, RegisterType im,
+                         const StepConstants<RegisterType>& k)
+        {
+            using S = SIMD<RegisterType>;
+            const RegisterType next = S::mul_add(f, S::mul(im, k.dt2), S::mul_add(S::sub(p, prev), S::mul(k.damping, k.dtRatio), p));
+            v = S::mul(S::sub(next, p), k.invDt);
+            prev = p;
+            p = next;
+        }
+    };
+
+    // Predict / correct scheme of position based dynamics: the velocity of a step is the displacement of the
+    // particle once the constraints of the previous step have been projected, then the position is predicted from it.
+    // Constraint solvers only need to move positions, the velocity change follows at the next step.
+    struct PositionBased
+    {
+        static constexpr bool keeps_previous_position = true;
+
+        template <typename RegisterType>
+        static void step(RegisterType& p, RegisterType& v, RegisterType& prev, RegisterType f, RegisterType im,
+                         const StepConstants<RegisterType>& k)
+        {
+            using S = SIMD<RegisterType>;
+            v = S::mul_add(f, S::mul(im, k.dt), S::mul(S::mul(S::sub(p, prev), k.invPreviousDt), k.damping));
+            prev = p;
+            p = S::mul_add(v, k.dt, p);
+        }
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "physics/integrators.h"
+#include "physics/constants.h"
+
+#include <cstddef>
+
+// Integration kernel of LinearMotionSystem, compiled once per instruction set like the Vec3D_simd kernels (see
+// maths/vector_kernels.h) and picked at runtime with select_kernels<LinearKernels>().
+
+// Raw axis arrays of a chunk, so that the kernel can run on any register type including a single float.
+struct LinearLanes
+{
+    float* p[3];
+    float* v[3];
+    float* prev[3]; // null when the integrator does not keep the previous position
+    float* f[3];
+    const float* im;
+};
+
+struct LinearKernels
+{
+    // One step of PHYSICS_INTEGRATOR over the lanes [begin, end), both bounds being multiples of SIMD_MAX_WIDTH.
+    // Returns the largest squared speed met.
+    float (*integrate)(const LinearLanes& lanes, size_t begin, size_t end, float dt, float previousDt, float damping);
+};
+
+template <> const LinearKernels& kernels_for<LinearKernels, float>();
+template <> const LinearKernels& kernels_for<LinearKernels, __m128>();
+template <> const LinearKernels& kernels_for<LinearKernels, __m256>();
+template <> const LinearKernels& kernels_for<LinearKernels, __m512>();
+
+// One step of the integrator over the lanes [begin, end), both bounds being multiples of the register width.
+// Returns the largest squared speed met, so that the caller can adapt the next step without another pass.
+template <typename Integrator, typename RegisterType>
+float integrate_linear(const LinearLanes& lanes, size_t begin, size_t end, const integrators::StepConstants<RegisterType>& k)
+{
+    using S = SIMD<RegisterType>;
+
+    const RegisterType zero = S::zero();
+    RegisterType maxSpeed2 = zero;
+
+    for (size_t n = begin; n < end; n += S::width)
+    {
+        const RegisterType im = S::load(lanes.im + n);
+        RegisterType speed2 = zero;
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            RegisterType p = S::load(lanes.p[axis] + n);
+            RegisterType v = S::load(lanes.v[axis] + n);
+            RegisterType prev = zero;
+            if constexpr (Integrator::keeps_previous_position)
+            {
+                prev = S::load(lanes.prev[axis] + n);
+            }
+            Integrator::step(p, v, prev, S::load(lanes.f[axis] + n), im, k);
+            S::store(lanes.p[axis] + n, p);
+            S::store(lanes.v[axis] + n, v);
+            if constexpr (Integrator::keeps_previous_position)
+            {
+                S::store(lanes.prev[axis] + n, prev);
+            }
+            S::store(lanes.f[axis] + n, zero);
+            speed2 = S::mul_add(v, v, speed2);
+        }
+        maxSpeed2 = S::max(maxSpeed2, speed2);
+    }
+    return S::reduce_max(maxSpeed2);
+}
+
+// LinearKernels::integrate for one register type
+template <typename RegisterType>
+float integrate_linear_lanes(const LinearLanes& lanes, size_t begin, size_t end, float dt, float previousDt, float damping)
+{
+    const integrators::StepConstants<RegisterType> k(dt, previousDt, damping);
+    return integrate_linear<PHYSICS_INTEGRATOR>(lanes, begin, end, k);
+}
@@ -1,43 +1,131 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "maths/math.h"
+#include "physics/constants.h"
+#include "physics/integrators.h"
+#include "physics/slot_allocator.h"
 
-typedef struct
-{
-    math::vec3 p; // position
-    math::vec3 v; // velocity
-    math::vec3 f; // force
-    float     im; // inverse of mass
-} LinearData;
+class ThreadPool;
+
+using LinearHandle = SlotHandle;
 
+// Contiguous run of particles: particle k of the block lives in slot first.index() + k. A block never spans two chunks
+// of the pool, so its particles are also contiguous in memory.
+struct LinearBlock
+{
+    LinearHandle first;
+    size_t       count{ 0 };
+};
 
 class LinearMotionSystem
 {
 public:
-    explicit LinearMotionSystem(size_t size);
-
-    size_t new_linear_data(const math::vec3& position, const math::vec3& velocity, float mass);
-    void free_linear_data(size_t i);
-    void stop_linear_update(size_t i);
-    void resume_linear_update(size_t i);
-    math::vec3 get_linear_position(size_t i);
-    math::vec3 get_linear_velocity(size_t i);
-    void move_linear_position(size_t i, const math::vec3& offset);
-    void add_force(size_t i, const math::vec3& force);
-    void add_velocity(size_t i, const math::vec3& velocity);
-    void apply_impulse(size_t i, const math::vec3& impulse);
-    void set_mass(size_t i, float mass);
-    void update_data();
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1u << 16;
+
+    // The pool grows on demand by chunks of `chunkSize` particles (rounded up to a power of two), which is also the
+    // largest block that can be allocated.
+    explicit LinearMotionSystem(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    LinearHandle new_linear_data(const math::vec3& position, const math::vec3& velocity, float mass);
+    void free_linear_data(LinearHandle h);
+    void stop_linear_update(LinearHandle h);
+    void resume_linear_update(LinearHandle h);
+    [[nodiscard]] bool is_valid(LinearHandle h) const;
+    math::vec3 get_linear_position(LinearHandle h);
+    math::vec3 get_linear_velocity(LinearHandle h);
+    void move_linear_position(LinearHandle h, const math::vec3& offset);
+    void add_force(LinearHandle h, const math::vec3& force);
+    void add_velocity(LinearHandle h, const math::vec3& velocity);
+    void apply_impulse(LinearHandle h, const math::vec3& impulse);
+    void set_mass(LinearHandle h, float mass);
+
+    LinearBlock new_linear_block(size_t count, const math::vec3* positions, const math::vec3* velocities, const float* masses);
+    void free_linear_block(const LinearBlock& block);
+    [[nodiscard]] bool is_valid(const LinearBlock& block) const;
+    [[nodiscard]] LinearHandle get_linear_handle(const LinearBlock& block, size_t offset) const;
+    math::vec3 get_linear_position(const LinearBlock& block, size_t offset);
+    math::vec3 get_linear_velocity(const LinearBlock& block, size_t offset);
+    void move_linear_position(const LinearBlock& block, size_t offset, const math::vec3& offsetPosition);
+    void add_force(const LinearBlock& block, size_t offset, const math::vec3& force);
+    void apply_impulse(const LinearBlock& block, size_t offset, const math::vec3& impulse);
+    void set_mass(const LinearBlock& block, size_t offset, float mass);
+
+    // Sleeping support: a stopped block is skipped by update_data() but keeps accumulating forces and impulses, so
+    // that its owner can tell when something disturbed it.
+    void stop_linear_update(const LinearBlock& block);
+    void resume_linear_update(const LinearBlock& block);
+    void clear_linear_motion(const LinearBlock& block); // zero velocities and pending forces
+    [[nodiscard]] bool is_at_rest(const LinearBlock& block) const; // no velocity and no pending force
 
+    // Batched access: the block is validated once per call, offsets are particle offsets inside the block.
+    void gather_linear_positions(const LinearBlock& block, const size_t* offsets, size_t count, math::vec3* positions);
+    void gather_linear_velocities(const LinearBlock& block, const size_t* offsets, size_t count, math::vec3* velocities);
+    void gather_linear_positions(const LinearBlock& block, math::vec3* positions); // whole block
+    void scatter_impulses(const LinearBlock& block, const size_t* offsets, size_t count, const math::vec3* impulses);
+    void scatter_moves(const LinearBlock& block, const size_t* offsets, size_t count, const math::vec3* moves); // <- as move_linear_position()
+    void apply_impulses(const LinearBlock& block, const math::vec3* impulses); // whole block
+    void add_force(const LinearBlock& block, const math::vec3& force); // same force on every particle
+    void add_acceleration(const LinearBlock& block, const math::vec3& acceleration);
+
+    void update_data(float dt);
+    void set_thread_pool(ThreadPool* pool); // nullptr (the default) integrates on the calling thread
+    [[nodiscard]] ThreadPool* thread_pool() const; // also used by the constraint solvers working on the particles
+    [[nodiscard]] float time_step() const;        // step taken by the last update_data()
+    [[nodiscard]] float max_linear_speed() const; // fastest active particle after the last update_data()
+
+    [[nodiscard]] size_t capacity() const;
     [[nodiscard]] bool wrong_init() const;
 
 private:
-    size_t                        size;
-    size_t                        firstAvailable;
-    std::unique_ptr<LinearData[]> linearDataPool;
-    std::unique_ptr<bool[]>       linearDataUsed;
-    std::unique_ptr<bool[]>       linearDataSkip;
+    using Integrator = PHYSICS_INTEGRATOR;
+
+    static constexpr size_t BITS_PER_WORD = 64;
+    static constexpr size_t PARALLEL_GRAIN_WORDS = 16;                     // bitset words per worker range
+    static constexpr size_t PARALLEL_MIN_WORDS = 4 * PARALLEL_GRAIN_WORDS; // below this update_data() stays serial
+
+    // Fixed-size slice of the pool, allocated on demand and never moved once created.
+    struct Chunk
+    {
+        explicit Chunk(size_t size);
+
+        math::Vec3D_simd            positions; // structure of arrays, one aligned array per axis
+        math::Vec3D_simd            velocities;
+        math::Vec3D_simd            forces;
+        math::Vec3D_simd            previousPositions; // empty unless the integrator keeps it
+        aligned_unique_ptr<float[]> inverseMasses{ nullptr, std::free };
+        std::unique_ptr<uint64_t[]> usedMask;     // one bit per particle
+        std::unique_ptr<uint64_t[]> activeMask;   // used and not stopped, the only particles update_data() visits
+        size_t                      wordEnd{ 0 }; // one past the last bitset word that holds a used particle
+    };
+
+    void grow();
+    [[nodiscard]] Chunk& chunk_of(size_t i) const { return *chunks[i >> chunkShift]; }
+    [[nodiscard]] size_t local_index(size_t i) const { return i & (chunkSize - 1); }
+    void mark_used(size_t i);
+    void mark_free(size_t i);
+    void set_active(const LinearBlock& block, bool active);
+    struct StepParameters
+    {
+        float dt;
+        float previousDt;
+        float damping;
+    };
+
+    float update_words(size_t begin, size_t end, const StepParameters& step); // global bitset word range
+    void add_to_velocity(Chunk& chunk, size_t i, const math::vec3& velocity); // keeps the previous position in sync
+    void reset_previous_position(Chunk& chunk, size_t i);
+
+    size_t                              chunkSize; // power of two, multiple of the bitset word size
+    size_t                              chunkShift;
+    SlotAllocator                       slots;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    ThreadPool*                         threadPool{ nullptr };
+    std::vector<float>                  rangeMaxSpeed2; // per worker range, reused between steps
+    float                               timeStep{ PHYSICS_TIME_STEP };
+    float                               maxSpeed{ 0.f };
 };
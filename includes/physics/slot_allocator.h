@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 32-bit versioned reference to a pool slot: the low bits hold the slot index, the high bits the generation the
+// slot had when it was handed out. Freeing a slot bumps its generation, so a handle kept after a free no longer
+// validates instead of silently aliasing whatever reuses the slot.
+struct SlotHandle
+{
+    static constexpr uint32_t INDEX_BITS = 24;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1u;
+    static constexpr uint32_t GENERATION_MASK = (1u << (32u - INDEX_BITS)) - 1u;
+    static constexpr uint32_t MAX_SLOTS = INDEX_MASK; // the all-ones index is reserved for the invalid handle
+
+    uint32_t value{ ~0u };
+
+    SlotHandle() = default;
+    SlotHandle(uint32_t index, uint32_t generation)
+        : value{ (index & INDEX_MASK) | ((generation & GENERATION_MASK) << INDEX_BITS) }
+    { }
+
+    [[nodiscard]] uint32_t index() const { return value & INDEX_MASK; }
+    [[nodiscard]] uint32_t generation() const { return value >> INDEX_BITS; }
+    [[nodiscard]] bool is_null() const { return value == ~0u; }
+
+    bool operator==(const SlotHandle& h) const { return value == h.value; }
+    bool operator!=(const SlotHandle& h) const { return value != h.value; }
+};
+
+// O(1) slot allocator: released slots are threaded into a LIFO free list through their own link entry, and slots
+// that were never handed out are taken from the end of the used range.
+// Runs of consecutive slots are handed out as a whole by allocate_range() and kept apart from the single slot free
+// list once released, so that they can be reused as a run. A run never straddles a page boundary, which lets the
+// owner store each page in its own memory chunk.
+class SlotAllocator
+{
+public:
+    explicit SlotAllocator(size_t capacity, size_t pageSize = SlotHandle::MAX_SLOTS);
+
+    void grow(size_t count); // add `count` slots at the end, existing handles stay valid
+
+    SlotHandle allocate();
+    bool release(SlotHandle handle);
+
+    SlotHandle allocate_range(size_t count); // handle of the first of `count` consecutive slots
+    bool release_range(SlotHandle first, size_t count);
+
+    [[nodiscard]] SlotHandle handle_at(uint32_t index) const
+    {
+        return { index, generations[index] };
+    }
+
+    [[nodiscard]] bool is_valid(SlotHandle handle) const
+    {
+        return handle.index() < this->end && generations[handle.index()] == handle.generation();
+    }
+
+    [[nodiscard]] size_t capacity() const { return this->size; }
+
+private:
+    static constexpr uint32_t END_OF_LIST = ~0u;
+
+    struct Range
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    size_t                size;
+    size_t                pageSize;
+    uint32_t              end;       // slots past this one have never been handed out
+    uint32_t              freeHead;  // most recently released slot
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> links;     // next free slot, only meaningful while the slot is free
+    std::vector<Range>    freeRanges;
+};
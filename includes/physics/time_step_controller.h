@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+// Adaptive step size: the step is chosen so that the fastest particle moves at most `cfl` times the length scale of
+// the scene (edge length, thickness) per step. The step shrinks at once during fast contact and grows back by at most
+// `growth` per step while the cloth is calm, always within [minStep, maxStep].
+class TimeStepController
+{
+public:
+    TimeStepController(float lengthScale, float minStep, float maxStep, float cfl = .5f, float growth = 1.1f);
+
+    // step to take after a step whose fastest particle moved at `maxSpeed`
+    float next(float maxSpeed);
+
+    [[nodiscard]] float current() const { return this->step; }
+
+private:
+    float maxDisplacement;
+    float minStep;
+    float maxStep;
+    float growth;
+    float step;
+};
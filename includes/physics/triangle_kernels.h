@@ -0,0 +1,247 @@
+#pragma once
+
+#include "maths/polar.h"
+#include "maths/simd.h"
+#include "maths/vector_kernels.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Triangle shape matching kernel of Cloth, compiled once per instruction set like the Vec3D_simd kernels (see
+// maths/vector_kernels.h) and picked at runtime with select_kernels<TriangleKernels>().
+
+// Array of structures of arrays: SIZE triangles per packet, one lane per triangle, with their rest state. The size is
+// the widest register so that every kernel works on whole registers of the same packets, a narrower one just takes
+// several registers per packet. The padding lanes of a packet repeat its first triangle with a zero weight, so that
+// they stay finite and never move anything.
+struct alignas(SIMD_MAX_ALIGNMENT) TrianglePacket
+{
+    static constexpr size_t SIZE = SIMD_MAX_WIDTH;
+
+    int32_t  position[3][SIZE]; // <- of each corner, index of its x in the positions array (3 floats per point)
+    uint32_t triangle[SIZE];    // <- index in Cloth::triangles
+    float    mass[3][SIZE];
+    float    invTotalMass[SIZE];
+    float    restU[3][SIZE];    // <- 2D rest coordinates around the rest center of mass, as Cloth::TriangleRest
+    float    restV[3][SIZE];
+    float    weight[3][SIZE];   // <- 1 / number of triangles of the corner, 0 in the padding lanes
+    float    invMass[3][SIZE];
+    uint32_t lanes;             // <- lanes holding a triangle, the first ones
+};
+
+// Offset of every corner of a packet, nothing is applied by the kernel.
+struct alignas(SIMD_MAX_ALIGNMENT) TriangleOffsets
+{
+    float x[3][TrianglePacket::SIZE];
+    float y[3][TrianglePacket::SIZE];
+    float z[3][TrianglePacket::SIZE];
+};
+
+// Lagrange multiplier of every corner constraint of a packet, XPBD only. Zeroed at the start of every step.
+struct alignas(SIMD_MAX_ALIGNMENT) TriangleLambdas
+{
+    float x[3][TrianglePacket::SIZE];
+    float y[3][TrianglePacket::SIZE];
+    float z[3][TrianglePacket::SIZE];
+};
+
+struct TriangleKernels
+{
+    // Shape matching of the packets [0, count) from `positions`, the normalizations follow NormalizeMode::EXACT or
+    // NormalizeMode::FAST.
+    void (*shape_matching)(const TrianglePacket* packets, size_t count, const float* positions, float stiffness, TriangleOffsets* offsets);
+    void (*fast_shape_matching)(const TrianglePacket* packets, size_t count, const float* positions, float stiffness, TriangleOffsets* offsets);
+    // Same with compliant constraints, alphaTilde being the compliance over dt^2. `average` scales the offsets by the
+    // weight of the corners, for Jacobi.
+    void (*xpbd_shape_matching)(const TrianglePacket* packets, size_t count, const float* positions, float alphaTilde, bool average,
+                                TriangleLambdas* lambdas, TriangleOffsets* offsets);
+    void (*fast_xpbd_shape_matching)(const TrianglePacket* packets, size_t count, const float* positions, float alphaTilde, bool average,
+                                     TriangleLambdas* lambdas, TriangleOffsets* offsets);
+};
+
+template <> const TriangleKernels& kernels_for<TriangleKernels, float>();
+template <> const TriangleKernels& kernels_for<TriangleKernels, __m128>();
+template <> const TriangleKernels& kernels_for<TriangleKernels, __m256>();
+template <> const TriangleKernels& kernels_for<TriangleKernels, __m512>();
+
+namespace triangle_kernels
+{
+    template <typename RegisterType>
+    struct Vec3Lanes
+    {
+        RegisterType x, y, z;
+    };
+
+    template <typename RegisterType, bool Fast>
+    Vec3Lanes<RegisterType> normalize(const Vec3Lanes<RegisterType>& a)
+    {
+        using S = SIMD<RegisterType>;
+        const RegisterType d = S::max(S::mul_add(a.z, a.z, S::mul_add(a.y, a.y, S::mul(a.x, a.x))), S::set1(1e-30f));
+        if constexpr (Fast)
+        {
+            const RegisterType invLength = math::vec3d_kernels::rsqrt_newton<RegisterType>(d);
+            return { S::mul(a.x, invLength), S::mul(a.y, invLength), S::mul(a.z, invLength) };
+        }
+        else
+        {
+            const RegisterType length = S::sqrt(d);
+            return { S::div(a.x, length), S::div(a.y, length), S::div(a.z, length) };
+        }
+    }
+
+    template <typename RegisterType>
+    Vec3Lanes<RegisterType> cross(const Vec3Lanes<RegisterType>& a, const Vec3Lanes<RegisterType>& b)
+    {
+        using S = SIMD<RegisterType>;
+        return {
+            S::sub(S::mul(a.y, b.z), S::mul(b.y, a.z)),
+            S::sub(S::mul(a.z, b.x), S::mul(b.z, a.x)),
+            S::sub(S::mul(a.x, b.y), S::mul(b.x, a.y))
+        };
+    }
+
+    template <typename RegisterType>
+    RegisterType dot(const Vec3Lanes<RegisterType>& a, const Vec3Lanes<RegisterType>& b)
+    {
+        using S = SIMD<RegisterType>;
+        return S::mul_add(a.z, b.z, S::mul_add(a.y, b.y, S::mul(a.x, b.x)));
+    }
+
+    // Lane-wise shape matching: gather the corners, project them on the triangle plane around the center of mass, take
+    // the rotation of the 2x2 polar decomposition of sum(m * x_i * x_i_0^T) and return, in the plane, how far each
+    // corner is from the rotated rest shape.
+    template <typename RegisterType, bool Fast>
+    void match(const TrianglePacket& packet, size_t n, const float* positions, Vec3Lanes<RegisterType>* axis, RegisterType* du, RegisterType* dv)
+    {
+        using S = SIMD<RegisterType>;
+        using V = Vec3Lanes<RegisterType>;
+        V vec[3];
+        RegisterType mass[3];
+        V cm{ S::zero(), S::zero(), S::zero() };
+        for (int i = 0; i < 3; i++)
+        {
+            vec[i] = { S::gather(positions, packet.position[i] + n),
+                       S::gather(positions + 1, packet.position[i] + n),
+                       S::gather(positions + 2, packet.position[i] + n) };
+            mass[i] = S::load(packet.mass[i] + n);
+            cm = { S::mul_add(vec[i].x, mass[i], cm.x), S::mul_add(vec[i].y, mass[i], cm.y), S::mul_add(vec[i].z, mass[i], cm.z) };
+        }
+        const RegisterType invTotalMass = S::load(packet.invTotalMass + n);
+        cm = { S::mul(cm.x, invTotalMass), S::mul(cm.y, invTotalMass), S::mul(cm.z, invTotalMass) };
+
+        const V side[2] = {
+            { S::sub(vec[1].x, vec[0].x), S::sub(vec[1].y, vec[0].y), S::sub(vec[1].z, vec[0].z) },
+            { S::sub(vec[2].x, vec[0].x), S::sub(vec[2].y, vec[0].y), S::sub(vec[2].z, vec[0].z) }
+        };
+        const V normal = normalize<RegisterType, Fast>(cross(side[0], side[1]));
+        axis[0] = normalize<RegisterType, Fast>(side[0]);
+        axis[1] = normalize<RegisterType, Fast>(cross(side[0], normal));
+
+        RegisterType u[3], v[3], restU[3], restV[3];
+        RegisterType a00 = S::zero(), a01 = S::zero(), a10 = S::zero(), a11 = S::zero(); // <- sum of m * x_i * x_i_0^T
+        for (int i = 0; i < 3; i++)
+        {
+            const V local{ S::sub(vec[i].x, cm.x), S::sub(vec[i].y, cm.y), S::sub(vec[i].z, cm.z) };
+            u[i] = dot(local, axis[0]);
+            v[i] = dot(local, axis[1]);
+            restU[i] = S::load(packet.restU[i] + n);
+            restV[i] = S::load(packet.restV[i] + n);
+            const RegisterType mu = S::mul(mass[i], u[i]);
+            const RegisterType mv = S::mul(mass[i], v[i]);
+            a00 = S::mul_add(mu, restU[i], a00);
+            a01 = S::mul_add(mu, restV[i], a01);
+            a10 = S::mul_add(mv, restU[i], a10);
+            a11 = S::mul_add(mv, restV[i], a11);
+        }
+        RegisterType cos, sin;
+        math::polar_rotation(a00, a01, a10, a11, cos, sin);
+
+        for (int i = 0; i < 3; i++)
+        {
+            du[i] = S::sub(S::sub(S::mul(cos, restU[i]), S::mul(sin, restV[i])), u[i]);
+            dv[i] = S::sub(S::mul_add(sin, restU[i], S::mul(cos, restV[i])), v[i]);
+        }
+    }
+
+    // PBD: the corners move by a `stiffness` share of the way to the goal, averaged over their triangles.
+    template <typename RegisterType, bool Fast>
+    void shape_matching(const TrianglePacket* packets, size_t count, const float* positions, float stiffness, TriangleOffsets* offsets)
+    {
+        using S = SIMD<RegisterType>;
+        const RegisterType k = S::set1(stiffness);
+        for (size_t p = 0; p < count; p++)
+        {
+            const TrianglePacket& packet = packets[p];
+            TriangleOffsets& out = offsets[p];
+            for (size_t n = 0; n < TrianglePacket::SIZE; n += S::width)
+            {
+                Vec3Lanes<RegisterType> axis[2];
+                RegisterType du[3], dv[3];
+                match<RegisterType, Fast>(packet, n, positions, axis, du, dv);
+                for (int i = 0; i < 3; i++)
+                {
+                    const RegisterType scale = S::mul(k, S::load(packet.weight[i] + n));
+                    const RegisterType u = S::mul(du[i], scale);
+                    const RegisterType v = S::mul(dv[i], scale);
+                    S::store(out.x[i] + n, S::mul_add(axis[0].x, u, S::mul(axis[1].x, v)));
+                    S::store(out.y[i] + n, S::mul_add(axis[0].y, u, S::mul(axis[1].y, v)));
+                    S::store(out.z[i] + n, S::mul_add(axis[0].z, u, S::mul(axis[1].z, v)));
+                }
+            }
+        }
+    }
+
+    // XPBD: each corner is held to its goal g by the constraint C = x - g of compliance alpha, with the goal taken as
+    // fixed. dlambda = (-C - alphaTilde * lambda) / (w + alphaTilde), alphaTilde = alpha / dt^2, and the corner moves
+    // by w * dlambda, times its weight when `average` (Jacobi).
+    template <typename RegisterType, bool Fast>
+    void xpbd_shape_matching(const TrianglePacket* packets, size_t count, const float* positions, float alphaTilde, bool average,
+                             TriangleLambdas* lambdas, TriangleOffsets* offsets)
+    {
+        using S = SIMD<RegisterType>;
+        const RegisterType alpha = S::set1(alphaTilde);
+        for (size_t p = 0; p < count; p++)
+        {
+            const TrianglePacket& packet = packets[p];
+            TriangleLambdas& lambda = lambdas[p];
+            TriangleOffsets& out = offsets[p];
+            for (size_t n = 0; n < TrianglePacket::SIZE; n += S::width)
+            {
+                Vec3Lanes<RegisterType> axis[2];
+                RegisterType du[3], dv[3];
+                match<RegisterType, Fast>(packet, n, positions, axis, du, dv);
+                for (int i = 0; i < 3; i++)
+                {
+                    const RegisterType w = S::load(packet.invMass[i] + n);
+                    const RegisterType invDenominator = S::div(S::set1(1.f), S::add(w, alpha));
+                    const RegisterType scale = average ? S::mul(w, S::load(packet.weight[i] + n)) : w;
+                    const RegisterType goal[3] = {
+                        S::mul_add(axis[0].x, du[i], S::mul(axis[1].x, dv[i])),
+                        S::mul_add(axis[0].y, du[i], S::mul(axis[1].y, dv[i])),
+                        S::mul_add(axis[0].z, du[i], S::mul(axis[1].z, dv[i]))
+                    };
+                    float* const l[3] = { lambda.x[i] + n, lambda.y[i] + n, lambda.z[i] + n };
+                    float* const o[3] = { out.x[i] + n, out.y[i] + n, out.z[i] + n };
+                    for (int a = 0; a < 3; a++)
+                    {
+                        const RegisterType last = S::load(l[a]);
+                        const RegisterType delta = S::mul(S::sub(goal[a], S::mul(alpha, last)), invDenominator);
+                        S::store(l[a], S::add(last, delta));
+                        S::store(o[a], S::mul(delta, scale));
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename RegisterType>
+    constexpr TriangleKernels make()
+    {
+        return {
+            &shape_matching<RegisterType, false>,
+            &shape_matching<RegisterType, true>,
+            &xpbd_shape_matching<RegisterType, false>,
+            &xpbd_shape_matching<RegisterType, true>
+        };
+    }
+}
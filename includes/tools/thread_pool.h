@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads for data-parallel loops. The workers sleep between jobs instead of being created
+// for each call, which matters when the physics step runs a few thousand times per second.
+class ThreadPool
+{
+public:
+    using Task = std::function<void(size_t begin, size_t end)>;
+
+    // `threadCount` includes the calling thread, 0 picks one thread per hardware thread.
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls task(begin, end) on consecutive ranges of at most `grain` items covering [0, count), and returns once
+    // every range has been processed. The calling thread takes ranges too. Not reentrant: a task must not call
+    // parallel_for() on the same pool.
+    void parallel_for(size_t count, size_t grain, const Task& task);
+
+    [[nodiscard]] size_t thread_count() const { return workers.size() + 1; }
+
+private:
+    void worker_loop();
+    void run_ranges();
+
+    std::vector<std::thread> workers;
+    std::mutex               mutex;
+    std::condition_variable  wakeUp;
+    std::condition_variable  jobDone;
+
+    const Task*         task{ nullptr };
+    size_t              count{ 0 };
+    size_t              grain{ 1 };
+    std::atomic<size_t> nextRange{ 0 };
+    size_t              pendingWorkers{ 0 }; // workers that have not finished the current job yet
+    uint64_t            job{ 0 };            // incremented for every parallel_for() call
+    bool                stopping{ false };
+};
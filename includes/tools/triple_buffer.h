@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer / single consumer triple buffer. The producer fills write_buffer() and publishes it, the
+// consumer picks the latest published buffer with update() and reads it until the next update(). Neither side ever
+// waits: the producer always owns one buffer, the consumer another, and the third one is swapped between them.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // producer side
+    T& write_buffer()
+    {
+        return buffers[writeIndex];
+    }
+
+    void publish()
+    {
+        const uint8_t previous = middle.exchange(static_cast<uint8_t>(writeIndex | FRESH), std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // consumer side, returns false when nothing was published since the last call
+    bool update()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+        {
+            return false;
+        }
+        const uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& read_buffer() const
+    {
+        return buffers[readIndex];
+    }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 3;
+    static constexpr uint8_t FRESH = 4; // <- set on the middle index when it holds a buffer the consumer has not seen
+
+    std::array<T, 3> buffers;
+    alignas(64) uint8_t writeIndex{ 0 }; // <- each side on its own cache line
+    alignas(64) std::atomic<uint8_t> middle{ 1 };
+    alignas(64) uint8_t readIndex{ 2 };
+};
@@ -11,7 +11,7 @@ CollisionData_Triangle::CollisionData_Triangle()
 {
 }
 
-CollisionData_Triangle::CollisionData_Triangle(size_t i1, size_t i2, size_t i3, float m1, float m2, float m3)
+CollisionData_Triangle::CollisionData_Triangle(LinearHandle i1, LinearHandle i2, LinearHandle i3, float m1, float m2, float m3)
     : i{i1, i2, i3}
     , m{m1, m2, m3}
 {
@@ -30,7 +30,7 @@ CollisionData_Edge::CollisionData_Edge()
 {
 }
 
-CollisionData_Edge::CollisionData_Edge(size_t i1, size_t i2, float m1, float m2)
+CollisionData_Edge::CollisionData_Edge(LinearHandle i1, LinearHandle i2, float m1, float m2)
     : i{i1, i2}
     , m{m1, m2}
 {
@@ -49,15 +49,15 @@ CollisionData_Point::CollisionData_Point()
 {
 }
 
-CollisionData_Point::CollisionData_Point(size_t lms_indice, float mass)
-    : i(lms_indice)
+CollisionData_Point::CollisionData_Point(LinearHandle lms_handle, float mass)
+    : i(lms_handle)
     , m(mass)
 {
 }
 
-CollisionData_Point::CollisionData_Point(size_t lms_indice, float mass, const math::vec3& position,
+CollisionData_Point::CollisionData_Point(LinearHandle lms_handle, float mass, const math::vec3& position,
                                          const math::vec3& velocity)
-    : i(lms_indice)
+    : i(lms_handle)
     , m(mass)
     , p(position)
     , v(velocity)
@@ -271,14 +271,17 @@ void ClothCollisionModel::setStiffess(float _stiffness)
 
 void ClothCollisionModel::init(Cloth& c)
 {
+    cloth = &c;
     thickness = c.thickness;
     triangles.resize(c.nbrOfTriangles);
     std::vector<AABB*> aabbs_lvl_inf;
     for (size_t n = 0; n < c.nbrOfTriangles; n++)
     {
         size_t iT[]{c.triangles[3 * n], c.triangles[3 * n + 1], c.triangles[3 * n + 2]};
-        triangles[n] = CollisionData_Triangle(c.posCur[iT[0]], c.posCur[iT[1]], c.posCur[iT[2]], c.mass[iT[0]],
-                                              c.mass[iT[1]], c.mass[iT[2]]);
+        triangles[n] = CollisionData_Triangle(_lms.get_linear_handle(c.particles, iT[0]),
+                                              _lms.get_linear_handle(c.particles, iT[1]),
+                                              _lms.get_linear_handle(c.particles, iT[2]),
+                                              c.mass[iT[0]], c.mass[iT[1]], c.mass[iT[2]]);
         updateTriangleData(n, false);
         // Create our first level of AABBs
         aabbs_lvl_inf.push_back(new AABB(triangles[n].p[0], triangles[n].p[1], triangles[n].p[2]));
@@ -350,7 +353,9 @@ void ClothCollisionModel::initGL(std::shared_ptr<Program> shaderProgram)
 
 void ClothCollisionModel::render(const math::mat& projMatrix) const
 {
-    if (toDraw.size() > 6)
+    drawSnapshots.update();
+    const std::vector<gl::GLfloat>& lines = drawSnapshots.read_buffer();
+    if (lines.size() > 6)
     {
         program->use();
 
@@ -368,13 +373,19 @@ void ClothCollisionModel::render(const math::mat& projMatrix) const
 
         gl::glBindVertexArray(VAO);
         gl::glBindBuffer(gl::GL_ARRAY_BUFFER, VBO);
-        gl::glBufferData(gl::GL_ARRAY_BUFFER, toDraw.size() * sizeof(gl::GLfloat), &toDraw[0], gl::GL_DYNAMIC_DRAW);
-        gl::glDrawArrays(gl::GL_LINES, 0, toDraw.size() / 3);
+        gl::glBufferData(gl::GL_ARRAY_BUFFER, lines.size() * sizeof(gl::GLfloat), &lines[0], gl::GL_DYNAMIC_DRAW);
+        gl::glDrawArrays(gl::GL_LINES, 0, lines.size() / 3);
         gl::glBindBuffer(gl::GL_ARRAY_BUFFER, 0);
         gl::glBindVertexArray(0);
     }
 }
 
+void ClothCollisionModel::publish()
+{
+    drawSnapshots.write_buffer() = toDraw;
+    drawSnapshots.publish();
+}
+
 void ClothCollisionModel::updateAllTriangleData()
 {
     for (size_t n = 0; n < triangles.size(); n++)
@@ -403,9 +414,13 @@ void ClothCollisionModel::updateTriangleData(size_t i, bool updateAABB, bool upd
     }
 }
 
-void ClothCollisionModel::resolveInternalCollisions()
+void ClothCollisionModel::resolveInternalCollisions(float dt)
 {
     toDraw.clear();
+    if (cloth != nullptr && cloth->isSleeping()) // <- nothing moves, no refit and no new contact
+    {
+        return;
+    }
     updateAllTriangleData();
     for (size_t i = 0; i < triangles.size(); i++)
     {
@@ -434,7 +449,7 @@ void ClothCollisionModel::resolveInternalCollisions()
                 {
                     collision_checked.push_back(indexOfT2);
                     CollisionData_Triangle& t2 = triangles[indexOfT2];
-                    resolveTriangleTriangleCollision(_lms, t1, t2);
+                    resolveTriangleTriangleCollision(_lms, t1, t2, dt);
                     updateTriangleData(i);
                     updateTriangleData(indexOfT2);
                 }
@@ -446,38 +461,40 @@ void ClothCollisionModel::resolveInternalCollisions()
 }
 
 void ClothCollisionModel::resolveTriangleTriangleCollision(LinearMotionSystem& _lms, CollisionData_Triangle& t1,
-                                                           CollisionData_Triangle& t2)
+                                                           CollisionData_Triangle& t2, float dt)
 {
     for (size_t n = 0; n < 3; n++)
     {
         if (t1.i[n] != t2.i[0] && t1.i[n] != t2.i[1] && t1.i[n] != t2.i[2])
         // <- if the point n of t1 is not also part of the CollisionData_Triangle t2 we check it against t2
         {
-            size_t i = t1.i[n];
             CollisionData_Point point(t1.i[n], t1.m[n], t1.p[n], t1.v[n]);
-            resolvePointTriangleCollision(_lms, point, t2, thickness, stiffness);
+            resolvePointTriangleCollision(_lms, point, t2, thickness, stiffness, dt);
         }
     }
 }
 
 bool ClothCollisionModel::resolvePointTriangleCollision(LinearMotionSystem& _lms, CollisionData_Point& p, CollisionData_Triangle& t,
-                                                        float threshold, float stiffnessCoefficient)
+                                                        float threshold, float stiffnessCoefficient, float dt)
 {
-    math::vec3 side[]{t.p[1] - t.p[0], t.p[2] - t.p[0]}; // triangle sides
-    math::vec3 normal = math::vec3::cross(side[0], side[1]).normalized();
-    float dst = math::vec3::dot(p.p - t.p[2], normal);
+    const math::vec3a tp[]{math::vec3a(t.p[0]), math::vec3a(t.p[1]), math::vec3a(t.p[2])};
+    const math::vec3a pp(p.p);
+    const math::NormalizeMode mode = math::get_normalize_mode();
+    math::vec3a side[]{tp[1] - tp[0], tp[2] - tp[0]}; // triangle sides
+    math::vec3a normal = math::vec3a::cross(side[0], side[1]).normalized(mode);
+    float dst = math::vec3a::dot(pp - tp[2], normal);
     if (dst < threshold) // Possible collision
     {
-        math::vec3 projP = p.p - (normal * dst);
-        math::vec3 vecP = projP - t.p[0];
+        math::vec3a projP = pp - (normal * dst);
+        math::vec3a vecP = projP - tp[0];
 
-        float dot00 = math::vec3::dot(side[0], side[0]); // <- can reuse it for every test on this triangle
-        float dot01 = math::vec3::dot(side[0], side[1]);
-        float dot11 = math::vec3::dot(side[1], side[1]);
+        float dot00 = math::vec3a::dot(side[0], side[0]); // <- can reuse it for every test on this triangle
+        float dot01 = math::vec3a::dot(side[0], side[1]);
+        float dot11 = math::vec3a::dot(side[1], side[1]);
         float invDenom = 1.f / ((dot00 * dot11) - (dot01 * dot01));
 
-        float dotP0 = math::vec3::dot(vecP, side[0]); // <- calculate barycentric coordinates
-        float dotP1 = math::vec3::dot(vecP, side[1]);
+        float dotP0 = math::vec3a::dot(vecP, side[0]); // <- calculate barycentric coordinates
+        float dotP1 = math::vec3a::dot(vecP, side[1]);
         float w[3]{
             0.f,
             ((dot11 * dotP0) - (dot01 * dotP1)) * invDenom,
@@ -488,7 +505,7 @@ bool ClothCollisionModel::resolvePointTriangleCollision(LinearMotionSystem& _lms
         bool insideTriangle(true); // <- test if we are in the triangle +- the threshold
         for (int n = 0; n < 3; n++)
         {
-            float relThreshold = threshold / t.p[n].length();
+            float relThreshold = threshold / tp[n].length(mode);
             if (w[n] < -relThreshold || w[n] > 1 + relThreshold)
             {
                 insideTriangle = false;
@@ -499,46 +516,46 @@ bool ClothCollisionModel::resolvePointTriangleCollision(LinearMotionSystem& _lms
         if (insideTriangle) // <- There is a collision
         {
             float length_vTN(0.f);
-            for (size_t n = 0; n < 3; n++) length_vTN += math::vec3::dot(t.v[n] * w[n], normal);
-            math::vec3 vTN = length_vTN * normal;
-            math::vec3 vPN = math::vec3::dot(p.v, normal) * normal;
-            math::vec3 vN_rel = vPN - vTN;
+            for (size_t n = 0; n < 3; n++) length_vTN += math::vec3a::dot(math::vec3a(t.v[n]) * w[n], normal);
+            math::vec3a vTN = length_vTN * normal;
+            math::vec3a vPN = math::vec3a::dot(math::vec3a(p.v), normal) * normal;
+            math::vec3a vN_rel = vPN - vTN;
 
             float mT = t.m[0] * w[0] + t.m[1] * w[1] + t.m[2] * w[2];
-            math::vec3 Ic_t(0.f, 0.f, 0.f), Ic_p(0.f, 0.f, 0.f);
+            math::vec3a Ic_t(0.f, 0.f, 0.f), Ic_p(0.f, 0.f, 0.f);
 
-            if (math::vec3::dot(vN_rel, normal) <= FLOATING_ERROR_COUNTERING)
+            if (math::vec3a::dot(vN_rel, normal) <= FLOATING_ERROR_COUNTERING)
             // <- if the point is moving toward the triangle we stop the relative movement
             {
                 Ic_t = 0.5f * mT * vN_rel; // <- Counter relative velocity
                 Ic_p = 0.5f * p.m * -vN_rel; // <- p.m : mass of the point
-                vN_rel = math::vec3(0.f, 0.f, 0.f);
+                vN_rel = math::vec3a(0.f, 0.f, 0.f);
 
                 float o = std::max(threshold - (dst * 0.5f), 0.f); // <- overlap
-                float Vr_length_max = o * LIMIT_COLLISION_PUSH_APART_FACTOR * INV_PHYSICS_TIME_STEP - vN_rel.
+                float Vr_length_max = o * LIMIT_COLLISION_PUSH_APART_FACTOR * (1.f / dt) - vN_rel.
                     length();
                 float Ir_t_length_max = mT * Vr_length_max;
                 float Ir_p_length_max = p.m * Vr_length_max;
 
-                float Ir_length = stiffnessCoefficient * o * PHYSICS_TIME_STEP;
-                math::vec3 Ir_t = -std::min(Ir_t_length_max, Ir_length) * normal;
-                math::vec3 Ir_p = std::min(Ir_p_length_max, Ir_length) * normal;
+                float Ir_length = stiffnessCoefficient * o * dt;
+                math::vec3a Ir_t = -std::min(Ir_t_length_max, Ir_length) * normal;
+                math::vec3a Ir_p = std::min(Ir_p_length_max, Ir_length) * normal;
 
-                for (size_t n = 0; n < 3; n++) _lms.apply_impulse(t.i[n], w[n] * (Ic_t + Ir_t));
-                _lms.apply_impulse(p.i, Ic_p + Ir_p);
+                for (size_t n = 0; n < 3; n++) _lms.apply_impulse(t.i[n], (w[n] * (Ic_t + Ir_t)).to_vec3());
+                _lms.apply_impulse(p.i, (Ic_p + Ir_p).to_vec3());
                 nbrOfCollisions++;
                 toDraw.push_back(p.p.x);
                 toDraw.push_back(p.p.y);
                 toDraw.push_back(p.p.z);
-                math::vec3 pAfter = p.p + (o * stiffnessCoefficient * normal);
+                math::vec3 pAfter = (pp + (o * stiffnessCoefficient * normal)).to_vec3();
                 toDraw.push_back(pAfter.x);
                 toDraw.push_back(pAfter.y);
                 toDraw.push_back(pAfter.z);
 
-                toDraw.push_back(projP.x);
-                toDraw.push_back(projP.y);
-                toDraw.push_back(projP.z);
-                math::vec3 ppAfter = projP - (o * stiffnessCoefficient * normal);
+                toDraw.push_back(projP.x());
+                toDraw.push_back(projP.y());
+                toDraw.push_back(projP.z());
+                math::vec3 ppAfter = (projP - (o * stiffnessCoefficient * normal)).to_vec3();
                 toDraw.push_back(ppAfter.x);
                 toDraw.push_back(ppAfter.y);
                 toDraw.push_back(ppAfter.z);
@@ -5,11 +5,106 @@
 #include "maths/math.h"
 #include "physics/constants.h"
 #include "physics/motion_system.h"
+#include "tools/thread_pool.h"
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
 
 gl::GLuint shaderProgram;
 
+namespace
+{
+    // Greedy colouring in index order, so that a given mesh always gets the same colours: an element takes the first
+    // colour that none of its vertices has yet. `elements` holds `stride` vertex indices per element and is sorted by
+    // colour, keeping the index order inside a colour. Returns where each colour starts, followed by the element count.
+    std::vector<size_t> colourElements(size_t* elements, size_t nbrOfElements, size_t stride, size_t nbrOfPoints)
+    {
+        std::vector<std::vector<size_t>> vertexColours(nbrOfPoints);
+        std::vector<size_t> colour(nbrOfElements);
+        std::vector<size_t> taken; // <- taken[c] == e when a vertex of element e already has colour c
+        for (size_t e = 0; e < nbrOfElements; e++)
+        {
+            for (size_t k = 0; k < stride; k++)
+            {
+                for (size_t c : vertexColours[elements[e * stride + k]])
+                {
+                    taken[c] = e;
+                }
+            }
+            size_t c = 0;
+            while (c < taken.size() && taken[c] == e)
+            {
+                c++;
+            }
+            if (c == taken.size())
+            {
+                taken.push_back(std::numeric_limits<size_t>::max());
+            }
+            colour[e] = c;
+            for (size_t k = 0; k < stride; k++)
+            {
+                vertexColours[elements[e * stride + k]].push_back(c);
+            }
+        }
+
+        std::vector<size_t> colourStart(taken.size() + 1, 0);
+        for (size_t e = 0; e < nbrOfElements; e++)
+        {
+            colourStart[colour[e] + 1]++;
+        }
+        for (size_t c = 0; c < taken.size(); c++)
+        {
+            colourStart[c + 1] += colourStart[c];
+        }
+        std::vector<size_t> next(colourStart.begin(), colourStart.end() - 1);
+        std::vector<size_t> sorted(nbrOfElements * stride);
+        for (size_t e = 0; e < nbrOfElements; e++)
+        {
+            std::copy(elements + e * stride, elements + (e + 1) * stride, sorted.begin() + next[colour[e]]++ * stride);
+        }
+        std::copy(sorted.begin(), sorted.end(), elements);
+        return colourStart;
+    }
+
+    // Packets of each colour when the elements of every colour are packed by `size`, in the same layout as colourStart.
+    std::vector<size_t> packetColours(const std::vector<size_t>& colourStart, size_t size)
+    {
+        std::vector<size_t> packetStart(1, 0);
+        for (size_t c = 0; c + 1 < colourStart.size(); c++)
+        {
+            packetStart.push_back(packetStart.back() + (colourStart[c + 1] - colourStart[c] + size - 1) / size);
+        }
+        return packetStart;
+    }
+
+    // Gauss-Seidel over the colours one after the other, the constraints of a colour in parallel by ranges of `grain`.
+    // They share no vertex, so the result does not depend on how the ranges are spread over the threads.
+    template <typename Solve>
+    void solveByColour(ThreadPool* pool, const std::vector<size_t>& colourStart, size_t grain, const Solve& solve)
+    {
+        for (size_t c = 0; c + 1 < colourStart.size(); c++)
+        {
+            const size_t first = colourStart[c];
+            const size_t count = colourStart[c + 1] - first;
+            if (pool == nullptr || count < 4 * grain)
+            {
+                for (size_t n = first; n < first + count; n++)
+                {
+                    solve(n);
+                }
+                continue;
+            }
+            pool->parallel_for(count, grain, [first, &solve](size_t begin, size_t end) {
+                for (size_t n = first + begin; n < first + end; n++)
+                {
+                    solve(n);
+                }
+            });
+        }
+    }
+}
+
 void Cloth::allocateSpace(size_t size_h, size_t size_w)
 {
     nbrOfPoints = size_h * size_w;
@@ -22,14 +117,12 @@ void Cloth::allocateSpace(size_t size_h, size_t size_w)
     invNbrAdjTriangles = new float[nbrOfPoints];
     invNbrAdjEdges = new float[nbrOfPoints];
     mass = new float[nbrOfPoints];
+    triangleRest = make_aligned_unique<TriangleRest[]>(nbrOfTriangles, CACHE_LINE_SIZE);
     posInit = new math::vec3[nbrOfPoints];
-    posCur = new size_t[nbrOfPoints];
+    windowStart = new math::vec3[nbrOfPoints];
 
     vertex_t = new gl::GLfloat[nbrOfPoints * 3]; // only positions, use static IBO
     vertex_e = new gl::GLfloat[nbrOfEdges * 2 * 4]; // only positions, no IBO because 1 color per edge (4) because x, y, z, strain
-#ifdef UPDATE_ALL_AT_ONCE
-    correction = new math::vec3[nbrOfPoints];
-#endif
 }
 
 void Cloth::setColor(float r, float g, float b, float a)
@@ -71,10 +164,15 @@ void Cloth::updateMass()
         mass[indexPoint[1]] += massPerPoint;
         mass[indexPoint[2]] += massPerPoint;
     }
+    totalMass = 0.f;
     for (size_t n = 0; n < nbrOfPoints; n++)
     {
-        _lms.set_mass(posCur[n], mass[n]);
+        _lms.set_mass(particles, n, mass[n]);
+        totalMass += mass[n];
     }
+    updateTriangleRest();
+    updateEdgePackets();
+    updateRegionRest();
 }
 
 void Cloth::setDensity(float _density)
@@ -87,6 +185,49 @@ void Cloth::setStiffness(float triangle, float edge)
 {
     triangleStiffness = triangle;
     edgeStiffness = edge;
+    updateEdgePackets();
+}
+
+void Cloth::setConstraintModel(ConstraintModel _model)
+{
+    model = _model;
+}
+
+void Cloth::setCompliance(float triangle, float edge)
+{
+    triangleCompliance = std::max(0.f, triangle);
+    edgeCompliance = edge;
+    updateEdgePackets();
+}
+
+void Cloth::setRegionStiffness(float region)
+{
+    regionStiffness = region;
+}
+
+void Cloth::setRegionLevels(int levels)
+{
+    regionLevels = std::max(0, levels);
+    initRegions();
+}
+
+void Cloth::setConstraintSolver(ConstraintSolver _solver)
+{
+    solver = _solver;
+}
+
+void Cloth::setSolverIterations(int iterations)
+{
+    solverIterations = std::max(1, iterations);
+    estimatedRho = -1.f; // <- the estimate depends on the number of iterations
+    probedSteps = 0;
+}
+
+void Cloth::setChebyshevRho(float rho)
+{
+    chebyshevRho = std::min(rho, CHEBYSHEV_MAX_RHO);
+    estimatedRho = -1.f; // <- probe again
+    probedSteps = 0;
 }
 
 void Cloth::setThickness(float _thickness)
@@ -121,28 +262,297 @@ void Cloth::updateNbrTriangleAndEdgePerPoint()
     }
 }
 
+void Cloth::colourConstraints()
+{
+    triangleColourStart = colourElements(triangles, nbrOfTriangles, 3, nbrOfPoints);
+    edgeColourStart = colourElements(edges, nbrOfEdges, 2, nbrOfPoints);
+}
+
+void Cloth::updatePointAdjacency()
+{
+    // counting sort of the slots by point, a point gets its slots in increasing order
+    const auto build = [this](const size_t* elements, size_t nbrOfSlots, std::vector<size_t>& start, std::vector<size_t>& slot) {
+        start.assign(nbrOfPoints + 1, 0);
+        for (size_t k = 0; k < nbrOfSlots; k++)
+        {
+            start[elements[k] + 1]++;
+        }
+        for (size_t n = 0; n < nbrOfPoints; n++)
+        {
+            start[n + 1] += start[n];
+        }
+        std::vector<size_t> next(start.begin(), start.end() - 1);
+        slot.resize(nbrOfSlots);
+        for (size_t k = 0; k < nbrOfSlots; k++)
+        {
+            slot[next[elements[k]]++] = k;
+        }
+    };
+    build(triangles, nbrOfTriangles * 3, pointTriangleStart, pointTriangleSlot);
+    build(edges, nbrOfEdges * 2, pointEdgeStart, pointEdgeSlot);
+    triangleOffset.resize(nbrOfTriangles * 3);
+    edgeOffset.resize(nbrOfEdges * 2);
+    jacobiPrevious.resize(nbrOfPoints);
+    jacobiResidual.resize(nbrOfPoints);
+    positionScratch.resize(nbrOfPoints);
+}
+
+void Cloth::updateTriangleRest()
+{
+    for (size_t n = 0; n < nbrOfTriangles; n++)
+    {
+        const size_t indexPoint[3] = {
+            triangles[3 * n],
+            triangles[3 * n + 1],
+            triangles[3 * n + 2]
+        };
+        const math::vec3a vec[3] = {
+            math::vec3a(posInit[indexPoint[0]]),
+            math::vec3a(posInit[indexPoint[1]]),
+            math::vec3a(posInit[indexPoint[2]])
+        };
+        TriangleRest rest;
+        rest.invTotalMass = 1.f / (mass[indexPoint[0]] + mass[indexPoint[1]] + mass[indexPoint[2]]);
+        const math::vec3a side[] = {vec[1] - vec[0], vec[2] - vec[0]};
+        const math::vec3a normal = math::vec3a::cross(side[0], side[1]).normalized();
+        const math::vec3a axis[] = {side[0].normalized(), math::vec3a::cross(side[0], normal).normalized()};
+        const math::vec3a cm = ((vec[0] * mass[indexPoint[0]]) + (vec[1] * mass[indexPoint[1]]) + (vec[2] * mass[indexPoint[2]])) * rest.invTotalMass;
+        for (int i = 0; i < 3; i++)
+        {
+            rest.coord[0][i] = math::vec3a::dot(vec[i] - cm, axis[0]);
+            rest.coord[1][i] = math::vec3a::dot(vec[i] - cm, axis[1]);
+        }
+        triangleRest[n] = rest;
+    }
+    updateTrianglePackets();
+}
+
+void Cloth::updateTrianglePackets()
+{
+    constexpr size_t SIZE = TrianglePacket::SIZE;
+    packetColourStart = packetColours(triangleColourStart, SIZE);
+    const size_t nbrOfPackets = packetColourStart.back();
+    if (nbrOfPackets == 0)
+    {
+        return;
+    }
+    trianglePackets = make_aligned_unique<TrianglePacket[]>(nbrOfPackets, alignof(TrianglePacket));
+    packetOffsets = make_aligned_unique<TriangleOffsets[]>(nbrOfPackets, alignof(TriangleOffsets));
+    triangleLambdas = make_aligned_unique<TriangleLambdas[]>(nbrOfPackets, alignof(TriangleLambdas));
+
+    for (size_t c = 0; c + 1 < packetColourStart.size(); c++)
+    {
+        for (size_t p = packetColourStart[c]; p < packetColourStart[c + 1]; p++)
+        {
+            TrianglePacket& packet = trianglePackets[p];
+            const size_t first = triangleColourStart[c] + (p - packetColourStart[c]) * SIZE;
+            packet.lanes = static_cast<uint32_t>(std::min(SIZE, triangleColourStart[c + 1] - first));
+            for (size_t lane = 0; lane < SIZE; lane++)
+            {
+                const size_t n = lane < packet.lanes ? first + lane : first; // <- padding repeats the first triangle
+                const TriangleRest& rest = triangleRest[n];
+                packet.triangle[lane] = static_cast<uint32_t>(n);
+                packet.invTotalMass[lane] = rest.invTotalMass;
+                for (size_t i = 0; i < 3; i++)
+                {
+                    const size_t point = triangles[3 * n + i];
+                    packet.position[i][lane] = static_cast<int32_t>(3 * point);
+                    packet.mass[i][lane] = mass[point];
+                    packet.restU[i][lane] = rest.coord[0][i];
+                    packet.restV[i][lane] = rest.coord[1][i];
+                    packet.weight[i][lane] = lane < packet.lanes ? invNbrAdjTriangles[point] : 0.f;
+                    packet.invMass[i][lane] = 1.f / mass[point];
+                }
+            }
+        }
+    }
+}
+
+void Cloth::updateEdgePackets()
+{
+    constexpr size_t SIZE = EdgePacket::SIZE;
+    edgePacketColourStart = packetColours(edgeColourStart, SIZE);
+    const size_t nbrOfPackets = edgePacketColourStart.back();
+    if (nbrOfPackets == 0)
+    {
+        return;
+    }
+    edgePackets = make_aligned_unique<EdgePacket[]>(nbrOfPackets, alignof(EdgePacket));
+    edgePacketOffsets = make_aligned_unique<EdgeOffsets[]>(nbrOfPackets, alignof(EdgeOffsets));
+    edgeLambdas = make_aligned_unique<EdgeLambdas[]>(nbrOfPackets, alignof(EdgeLambdas));
+
+    for (size_t c = 0; c + 1 < edgePacketColourStart.size(); c++)
+    {
+        for (size_t p = edgePacketColourStart[c]; p < edgePacketColourStart[c + 1]; p++)
+        {
+            EdgePacket& packet = edgePackets[p];
+            const size_t first = edgeColourStart[c] + (p - edgePacketColourStart[c]) * SIZE;
+            packet.lanes = static_cast<uint32_t>(std::min(SIZE, edgeColourStart[c + 1] - first));
+            for (size_t lane = 0; lane < SIZE; lane++)
+            {
+                const size_t n = lane < packet.lanes ? first + lane : first; // <- padding repeats the first edge
+                const size_t point[2] = { edges[2 * n], edges[2 * n + 1] };
+                const float invMass[2] = { 1.f / mass[point[0]], 1.f / mass[point[1]] };
+                packet.edge[lane] = static_cast<uint32_t>(n);
+                packet.restLength[lane] = (posInit[point[1]] - posInit[point[0]]).length();
+                packet.stiffness[lane] = edgeStiffness;
+                packet.compliance[lane] = std::max(0.f, edgeCompliance);
+                for (size_t i = 0; i < 2; i++)
+                {
+                    packet.position[i][lane] = static_cast<int32_t>(3 * point[i]);
+                    packet.weight[i][lane] = lane < packet.lanes ? invMass[i] / (invMass[0] + invMass[1]) * invNbrAdjEdges[point[i]] : 0.f;
+                    packet.invMass[i][lane] = invMass[i];
+                    packet.invNbrEdges[i][lane] = lane < packet.lanes ? invNbrAdjEdges[point[i]] : 0.f;
+                }
+            }
+        }
+    }
+}
+
+void Cloth::initRegions()
+{
+    std::vector<std::vector<size_t>> adjacent(nbrOfPoints); // <- 1-ring of every vertex through the triangles
+    for (size_t n = 0; n < nbrOfTriangles * 3; n += 3)
+    {
+        for (size_t i = 0; i < 3; i++)
+            for (size_t j = 0; j < 3; j++)
+            {
+                std::vector<size_t>& list = adjacent[triangles[n + i]];
+                if (i != j && std::find(list.begin(), list.end(), triangles[n + j]) == list.end())
+                {
+                    list.push_back(triangles[n + j]);
+                }
+            }
+    }
+
+    std::vector<int> ring(nbrOfPoints, -1); // <- rings between a vertex and the center of the region being built
+    std::vector<int> countRegion(nbrOfPoints);
+    std::vector<bool> excluded(nbrOfPoints);
+    std::vector<size_t> reached;
+    size_t largestRegion = 0;
+    levelStart.assign(1, 0);
+    regionStart.assign(1, 0);
+    regionMembers.clear();
+    regionWeight.clear();
+    for (int level = 1; level <= regionLevels; level++)
+    {
+        const int radius = 1 << (level - 1);
+        const size_t firstMember = regionMembers.size();
+        std::fill(countRegion.begin(), countRegion.end(), 0);
+        std::fill(excluded.begin(), excluded.end(), false);
+        for (size_t n = 0; n < nbrOfPoints; n++)
+        {
+            if (excluded[n])
+            {
+                continue;
+            }
+            reached.assign(1, n); // <- breadth first up to `radius` rings, the center comes first in its region
+            ring[n] = 0;
+            for (size_t k = 0; k < reached.size(); k++)
+            {
+                const size_t i = reached[k];
+                if (ring[i] < radius)
+                {
+                    for (size_t j : adjacent[i])
+                    {
+                        if (ring[j] < 0)
+                        {
+                            ring[j] = ring[i] + 1;
+                            reached.push_back(j);
+                        }
+                    }
+                }
+            }
+            for (size_t i : reached)
+            {
+                excluded[i] = excluded[i] || ring[i] < radius; // <- centers of a level are `radius` rings apart at least
+                ring[i] = -1;
+                regionMembers.push_back(i);
+                countRegion[i]++;
+            }
+            regionStart.push_back(regionMembers.size());
+            largestRegion = std::max(largestRegion, reached.size());
+        }
+        for (size_t k = firstMember; k < regionMembers.size(); k++)
+        {
+            regionWeight.push_back(1.f / countRegion[regionMembers[k]]); // <- every vertex is in the region of a center
+        }
+        for (size_t k = firstMember; k < regionMembers.size(); k++)
+        {
+            if (std::find(fixedPoints.begin(), fixedPoints.end(), regionMembers[k]) != fixedPoints.end())
+            {
+                regionWeight[k] = 0.f; // <- moving a pinned vertex only to have the pin pull it back makes the regions diverge
+            }
+        }
+        levelStart.push_back(regionStart.size() - 1);
+    }
+    regionRotation.assign(regionStart.size() - 1, math::quat(1.f, 0.f, 0.f, 0.f));
+    regionScratch.resize(largestRegion);
+    updateRegionRest();
+}
+
+void Cloth::updateRegionRest()
+{
+    const size_t nbrOfRegions = regionStart.empty() ? 0 : regionStart.size() - 1;
+    regionRest.resize(regionMembers.size());
+    regionInvMass.resize(nbrOfRegions);
+    for (size_t r = 0; r < nbrOfRegions; r++)
+    {
+        float regionMass = 0.f;
+        math::vec3 cm(0.f, 0.f, 0.f);
+        for (size_t k = regionStart[r]; k < regionStart[r + 1]; k++)
+        {
+            regionMass += mass[regionMembers[k]];
+            cm += posInit[regionMembers[k]] * mass[regionMembers[k]];
+        }
+        regionInvMass[r] = 1.f / regionMass;
+        cm = cm * regionInvMass[r];
+        for (size_t k = regionStart[r]; k < regionStart[r + 1]; k++)
+        {
+            regionRest[k] = posInit[regionMembers[k]] - cm;
+        }
+    }
+}
+
 Cloth::Cloth(LinearMotionSystem& lms)
     : _lms(lms)
     , initialised(false)
+    , density(0)
+    , triangleStiffness(0)
+    , edgeStiffness(0)
+    , totalMass(0)
+    , nbrOfPoints(0)
+    , nbrOfTriangles(0)
+    , nbrOfEdges(0)
     , triangles(nullptr)
     , edges(nullptr)
+    , solver(ConstraintSolver::GAUSS_SEIDEL)
+    , model(ConstraintModel::PBD)
+    , triangleCompliance(0.f)
+    , edgeCompliance(0.f)
+    , stepInvDt2(0.f)
+    , solverIterations(1)
+    , chebyshevRho(0.f)
+    , estimatedRho(-1.f)
+    , probedSteps(0)
     , invNbrAdjTriangles(nullptr)
     , invNbrAdjEdges(nullptr)
     , mass(nullptr)
+    , triangleRest(nullptr, std::free)
+    , trianglePackets(nullptr, std::free)
+    , packetOffsets(nullptr, std::free)
+    , edgePackets(nullptr, std::free)
+    , edgePacketOffsets(nullptr, std::free)
+    , triangleLambdas(nullptr, std::free)
+    , edgeLambdas(nullptr, std::free)
+    , regionStiffness(0)
+    , regionLevels(3)
     , posInit(nullptr)
-    , posCur(nullptr)
     , vertex_t(nullptr)
     , vertex_e(nullptr)
-    ,
-#ifdef UPDATE_ALL_AT_ONCE
-    correction(nullptr),
-#endif
-    density(0)
-    , triangleStiffness(0)
-    , edgeStiffness(0)
-    , nbrOfPoints(0)
-    , nbrOfTriangles(0)
-    , nbrOfEdges(0)
+    , sleeping(false)
+    , windowTime(0.f)
+    , windowStart(nullptr)
 {
 }
 
@@ -151,19 +561,24 @@ Cloth::Cloth(LinearMotionSystem& lms, const math::vec3& pos, const math::vec3& a
 {
     width = size_w;
     allocateSpace(size_h, size_w);
+    fixedPoints = {0, width - 1, nbrOfPoints - 1};
     // CREATE POINTS
     math::vec3 stepRow = axis_h * step_h;
     math::vec3 stepCol = axis_w * step_w;
     for (size_t row = 0; row < size_h; row++)
     {
-        for (size_t col = 0; col < size_h; col++)
+        for (size_t col = 0; col < size_w; col++)
         {
             math::vec3 pointPos = pos + ((float)row * stepRow) + ((float)col * stepCol);
             size_t n = (row * size_w) + col;
             posInit[n] = pointPos;
-            posCur[n] = _lms.new_linear_data(pointPos, math::vec3(0.f, 0.f, 0.f), 1.f); // <- we will update the mass later
+            mass[n] = 1.f; // <- we will update the mass later
         }
     }
+    totalMass = (float)nbrOfPoints;
+    particles = _lms.new_linear_block(nbrOfPoints, posInit, nullptr, mass);
+    std::copy(posInit, posInit + nbrOfPoints, windowStart);
+    publish();
     // CREATE EDGES AND TRIANGLES LISTS
     size_t i = 0;
     for (size_t row = 0; row < size_h - 1; row++)
@@ -206,7 +621,12 @@ Cloth::Cloth(LinearMotionSystem& lms, const math::vec3& pos, const math::vec3& a
         edges[i + 1] = b;
         i += 2;
     }
+    colourConstraints();
+    updatePointAdjacency();
     updateNbrTriangleAndEdgePerPoint();
+    updateTriangleRest();
+    updateEdgePackets();
+    initRegions();
 }
 
 Cloth::~Cloth()
@@ -217,19 +637,16 @@ Cloth::~Cloth()
         gl::glDeleteBuffers(2, VBO.data());
         gl::glDeleteBuffers(1, &IBO);
     }
-    for (size_t i = 0; i < nbrOfPoints; i++) _lms.free_linear_data(posCur[i]);
+    if (_lms.is_valid(particles)) _lms.free_linear_block(particles);
     SAFE_DELETE_TAB(triangles);
     SAFE_DELETE_TAB(edges);
     SAFE_DELETE_TAB(invNbrAdjTriangles);
     SAFE_DELETE_TAB(invNbrAdjEdges);
     SAFE_DELETE_TAB(mass);
     SAFE_DELETE_TAB(posInit);
-    SAFE_DELETE_TAB(posCur);
+    SAFE_DELETE_TAB(windowStart);
     SAFE_DELETE_TAB(vertex_t);
     SAFE_DELETE_TAB(vertex_e);
-#ifdef UPDATE_ALL_AT_ONCE
-    SAFE_DELETE_TAB(correction);
-#endif
 }
 
 void Cloth::initGL(std::shared_ptr<Program> uniformColorProgram, std::shared_ptr<Program> strainColorProgram)
@@ -277,6 +694,13 @@ void Cloth::render(const math::mat& projMatrix) const
     bool renderTriangles{ true };
     bool renderEdges{ true };
 
+    snapshots.update();
+    const std::vector<math::vec3>& positions = snapshots.read_buffer();
+    if (positions.size() != nbrOfPoints)
+    {
+        return;
+    }
+
     if (renderTriangles)
     {
         program[UNIFORM_COLOR]->use();
@@ -289,7 +713,7 @@ void Cloth::render(const math::mat& projMatrix) const
         for (size_t n = 0; n < nbrOfPoints; n++)
         {
             size_t i = 3 * n;
-            math::vec3 vec = _lms.get_linear_position(posCur[n]);
+            const math::vec3& vec = positions[n];
             vertex_t[i] = vec.x;
             vertex_t[i + 1] = vec.y;
             vertex_t[i + 2] = vec.z;
@@ -319,6 +743,7 @@ void Cloth::render(const math::mat& projMatrix) const
                 gl::glUniformMatrix4fv(matrixUniform, 1, gl::GL_FALSE, projMatrix.data);
             }
 
+            const math::NormalizeMode mode = math::get_normalize_mode();
             for (size_t n = 0; n < nbrOfEdges; n++)
             {
                 size_t indexPoint[] = {
@@ -326,14 +751,14 @@ void Cloth::render(const math::mat& projMatrix) const
                     edges[2 * n + 1]
                 };
                 math::vec3 pos[] = {
-                    _lms.get_linear_position(indexPoint[0]),
-                    _lms.get_linear_position(indexPoint[1])
+                    positions[indexPoint[0]],
+                    positions[indexPoint[1]]
                 };
                 math::vec3 ini[] = {
                     posInit[indexPoint[0]],
                     posInit[indexPoint[1]],
                 };
-                float strain = abs(((pos[1] - pos[0]).length() / (ini[1] - ini[0]).length()) - 1.f);
+                float strain = abs(((pos[1] - pos[0]).length(mode) / (ini[1] - ini[0]).length(mode)) - 1.f);
                 size_t i = 8 * n;
                 //size_t i = 6 * n;
 
@@ -357,240 +782,358 @@ void Cloth::render(const math::mat& projMatrix) const
     }
 }
 
-void Cloth::applyTriangleShapeMatching(size_t iTriangle)
+void Cloth::publish()
 {
-    size_t indexPoint[3] = {
-        triangles[3 * iTriangle],
-        triangles[3 * iTriangle + 1],
-        triangles[3 * iTriangle + 2]
-    };
-    // 0 : current, 1 : initial
-    math::vec3 vec[2][3] = {
-        {
-            _lms.get_linear_position(indexPoint[0]),
-            _lms.get_linear_position(indexPoint[1]),
-            _lms.get_linear_position(indexPoint[2])
-        },
+    std::vector<math::vec3>& positions = snapshots.write_buffer();
+    positions.resize(nbrOfPoints);
+    _lms.gather_linear_positions(particles, positions.data());
+    snapshots.publish();
+}
+
+void Cloth::shapeMatchPackets(size_t begin, size_t end)
+{
+    static_assert(sizeof(math::vec3) == 3 * sizeof(float), "the packets index the positions as a float array");
+    const TriangleKernels& kernels = select_kernels<TriangleKernels>();
+    const bool fast = math::get_normalize_mode() == math::NormalizeMode::FAST;
+    if (model == ConstraintModel::XPBD)
+    {
+        const auto kernel = fast ? kernels.fast_xpbd_shape_matching : kernels.xpbd_shape_matching;
+        kernel(&trianglePackets[begin], end - begin, &positionScratch[0].x, triangleCompliance * stepInvDt2,
+               solver == ConstraintSolver::JACOBI, &triangleLambdas[begin], &packetOffsets[begin]);
+        return;
+    }
+    const auto kernel = fast ? kernels.fast_shape_matching : kernels.shape_matching;
+    kernel(&trianglePackets[begin], end - begin, &positionScratch[0].x, triangleStiffness, &packetOffsets[begin]);
+}
+
+void Cloth::solveTrianglesByColour()
+{
+    _lms.gather_linear_positions(particles, positionScratch.data()); // <- kept up to date with the moves below
+    solveByColour(_lms.thread_pool(), packetColourStart, PARALLEL_GRAIN_PACKETS, [this](size_t p) {
+        shapeMatchPackets(p, p + 1);
+        const TrianglePacket& packet = trianglePackets[p];
+        const TriangleOffsets& offset = packetOffsets[p];
+        size_t point[3 * TrianglePacket::SIZE];
+        math::vec3 move[3 * TrianglePacket::SIZE];
+        size_t count = 0;
+        for (size_t lane = 0; lane < packet.lanes; lane++)
         {
-            posInit[indexPoint[0]],
-            posInit[indexPoint[1]],
-            posInit[indexPoint[2]]
+            for (size_t i = 0; i < 3; i++, count++)
+            {
+                point[count] = packet.position[i][lane] / 3;
+                move[count] = math::vec3(offset.x[i][lane], offset.y[i][lane], offset.z[i][lane]);
+                positionScratch[point[count]] += move[count];
+            }
         }
-    };
-    float invTotalMass = 1.f / (mass[indexPoint[0]] + mass[indexPoint[1]] + mass[indexPoint[2]]);
-    math::vec3 cm[2];
-    math::mat projMat[2];
-    math::mat state[2];
-    for (size_t n = 0; n < 2; n++)
-    {
-        math::vec3 side[] = {vec[n][1] - vec[n][0], vec[n][2] - vec[n][0]};
-        math::vec3 normal = math::vec3::cross(side[0], side[1]).normalized();
-        math::vec3 axis[] = {side[0].normalized(), math::vec3::cross(side[0], normal).normalized()};
-        cm[n] = ((vec[n][0] * mass[indexPoint[0]]) + (vec[n][1] * mass[indexPoint[1]]) + (vec[n][2] * mass[indexPoint[2]])) * invTotalMass;
-
-        float data_ProjMat[] = {
-            axis[0].x, axis[0].y, axis[0].z,
-            axis[1].x, axis[1].y, axis[1].z
+        _lms.scatter_moves(particles, point, count, move);
+    });
+}
+
+void Cloth::solveTrianglesJacobi()
+{
+    ThreadPool* pool = _lms.thread_pool();
+    // plain iterations to measure their convergence, it takes two after the first one. XPBD stays plain: its
+    // multipliers already carry the previous iterations over.
+    const bool xpbd = model == ConstraintModel::XPBD;
+    const bool probing = !xpbd && chebyshevRho < 0.f && estimatedRho < 0.f && solverIterations >= 3;
+    const float rho = probing || xpbd ? 0.f : (chebyshevRho < 0.f ? estimatedRho : chebyshevRho);
+    float omega = 1.f;
+    float residual[2] = {0.f, 0.f}; // <- squared length of all the offsets, at the second and at the last iteration
+    const size_t nbrOfPackets = packetColourStart.back();
+    _lms.gather_linear_positions(particles, positionScratch.data()); // <- kept up to date with the moves below
+
+    for (int iteration = 0; iteration < solverIterations; iteration++)
+    {
+        // omega_1 = 1, omega_2 = 2 / (2 - rho^2), omega_k+1 = 4 / (4 - rho^2 * omega_k)
+        omega = iteration == 0 ? 1.f : (iteration == 1 ? 2.f / (2.f - rho * rho) : 4.f / (4.f - rho * rho * omega));
+        const float applied = iteration + 1 == solverIterations ? 1.f : omega;
+        const auto computeRange = [this](size_t begin, size_t end) {
+            shapeMatchPackets(begin, end);
+            for (size_t p = begin; p < end; p++)
+            {
+                const TrianglePacket& packet = trianglePackets[p];
+                const TriangleOffsets& offset = packetOffsets[p];
+                for (size_t lane = 0; lane < packet.lanes; lane++)
+                {
+                    for (size_t i = 0; i < 3; i++)
+                    {
+                        triangleOffset[3 * packet.triangle[lane] + i] = math::vec3(offset.x[i][lane], offset.y[i][lane], offset.z[i][lane]);
+                    }
+                }
+            }
         };
-        projMat[n] = math::mat(2, 3, data_ProjMat);
+        const auto applyRange = [this, omega = applied](size_t begin, size_t end) {
+            for (size_t n = begin; n < end; n++)
+            {
+                math::vec3 offset(0.f, 0.f, 0.f);
+                for (size_t k = pointTriangleStart[n]; k < pointTriangleStart[n + 1]; k++)
+                {
+                    offset += triangleOffset[pointTriangleSlot[k]];
+                }
+                jacobiResidual[n] = math::vec3::dot(offset, offset);
+                const math::vec3 position = positionScratch[n]; // <- same as the particle, without a handle check
+                if (omega != 1.f) // <- x_k+1 = omega * (x_k + offset - x_k-1) + x_k-1
+                {
+                    offset = (position + offset - jacobiPrevious[n]) * omega + jacobiPrevious[n] - position;
+                }
+                jacobiPrevious[n] = position;
+                _lms.move_linear_position(particles, n, offset);
+                positionScratch[n] = position + offset;
+            }
+        };
+        if (pool == nullptr || nbrOfTriangles < PARALLEL_MIN_CONSTRAINTS)
+        {
+            computeRange(0, nbrOfPackets);
+            applyRange(0, nbrOfPoints);
+        }
+        else
+        {
+            pool->parallel_for(nbrOfPackets, PARALLEL_GRAIN_PACKETS, computeRange);
+            pool->parallel_for(nbrOfPoints, PARALLEL_GRAIN_CONSTRAINTS, applyRange);
+        }
+
+        if (probing && iteration > 0)
+        {
+            float sum = 0.f;
+            for (size_t n = 0; n < nbrOfPoints; n++)
+            {
+                sum += jacobiResidual[n];
+            }
+            residual[iteration == 1 ? 0 : 1] = sum;
+        }
     }
 
-    math::mat def(2, 2);
-    def *= 0.f;
-    for (size_t n = 0; n < 3; n++)
+    if (probing && residual[0] > 0.f)
     {
-        math::mat x_i = projMat[0] * math::mat(vec[0][n] - cm[0]);
-        math::mat x_i_0 = projMat[1] * math::mat(vec[1][n] - cm[1]);
-        def += (x_i * math::mat::transpose(x_i_0)) * mass[indexPoint[n]];
+        // Average shrink factor of the offsets from one plain iteration to the next, the first iteration left out as it
+        // mostly removes the error of the integration. It grows with the number of iterations, as does the best rho.
+        probedRho[probedSteps] = std::pow(residual[1] / residual[0], .5f / float(solverIterations - 2));
+        if (++probedSteps == CHEBYSHEV_PROBE_STEPS)
+        {
+            // The median, as the first steps of a cloth at rest hardly move and give ratios close to 1.
+            std::nth_element(probedRho.begin(), probedRho.begin() + CHEBYSHEV_PROBE_STEPS / 2, probedRho.end());
+            const float ratio = probedRho[CHEBYSHEV_PROBE_STEPS / 2];
+            estimatedRho = std::min(ratio, CHEBYSHEV_MAX_RHO);
+        }
     }
-    float rot = 0.f;
-    if (def[0][0] != 0.f) rot = std::atan2(def[0][1], def[0][0]);
-    float cosR = cos(rot), sinR = sin(rot);
-    float data_nDef[] = {
-        cosR, sinR, def[0][2],
-        -sinR, cosR, def[1][2]
-    };
-    math::mat nDef(2, 3, data_nDef);
-
-    math::mat stateInit(3, 3);
-    for (size_t n = 0; n < 9; n++)
-        if (n < 6) stateInit.data[n] = state[1].data[n];
-        else stateInit.data[n] = 1.f;
-
-    math::mat goal = nDef * stateInit;
-    math::mat ofst = (goal - state[0]) * triangleStiffness;
+}
 
-    for (size_t n = 0; n < 3; n++) // <- project if back into 3D space
+void Cloth::distancePackets(size_t begin, size_t end)
+{
+    const EdgeKernels& kernels = select_kernels<EdgeKernels>();
+    const bool fast = math::get_normalize_mode() == math::NormalizeMode::FAST;
+    if (model == ConstraintModel::XPBD)
     {
-        float u = ofst[0][n] * invNbrAdjTriangles[indexPoint[n]];
-        float v = ofst[1][n] * invNbrAdjTriangles[indexPoint[n]];
-        math::vec3 correct((projMat[0][0][0] * u) + (projMat[0][1][0] * v), (projMat[0][0][1] * u) + (projMat[0][1][1] * v), (projMat[0][0][2] * u) + (projMat[0][1][2] * v));
-#ifdef UPDATE_ALL_AT_ONCE
-        correction[indexPoint[n]] += correct;
-#else
-        _lms.move_linear_position(posCur[indexPoint[n]], correct);
-#endif
+        const auto kernel = fast ? kernels.fast_xpbd_distance : kernels.xpbd_distance;
+        kernel(&edgePackets[begin], end - begin, &positionScratch[0].x, stepInvDt2, solver == ConstraintSolver::JACOBI,
+               &edgeLambdas[begin], &edgePacketOffsets[begin]);
+        return;
     }
+    const auto kernel = fast ? kernels.fast_distance : kernels.distance;
+    kernel(&edgePackets[begin], end - begin, &positionScratch[0].x, &edgePacketOffsets[begin]);
 }
 
-void Cloth::triangle2DCorrection(size_t iTriangle)
+bool Cloth::solvesEdges() const
 {
-    size_t indexPoint[3] = {
-        triangles[3 * iTriangle],
-        triangles[3 * iTriangle + 1],
-        triangles[3 * iTriangle + 2]
-    };
-    // 0 : current, 1 : initial
-    math::vec3 vec[2][3] = {
+    return model == ConstraintModel::XPBD ? edgeCompliance >= 0.f : edgeStiffness > 0.f;
+}
+
+void Cloth::solveEdgesByColour()
+{
+    solveByColour(_lms.thread_pool(), edgePacketColourStart, PARALLEL_GRAIN_PACKETS, [this](size_t p) {
+        distancePackets(p, p + 1);
+        const EdgePacket& packet = edgePackets[p];
+        const EdgeOffsets& offset = edgePacketOffsets[p];
+        size_t point[2 * EdgePacket::SIZE];
+        math::vec3 move[2 * EdgePacket::SIZE];
+        size_t count = 0;
+        for (size_t lane = 0; lane < packet.lanes; lane++)
         {
-            _lms.get_linear_position(indexPoint[0]),
-            _lms.get_linear_position(indexPoint[1]),
-            _lms.get_linear_position(indexPoint[2])
-        },
+            for (size_t i = 0; i < 2; i++, count++)
+            {
+                point[count] = packet.position[i][lane] / 3;
+                move[count] = math::vec3(offset.x[i][lane], offset.y[i][lane], offset.z[i][lane]);
+                positionScratch[point[count]] += move[count];
+            }
+        }
+        _lms.scatter_moves(particles, point, count, move);
+    });
+}
+
+void Cloth::solveEdgesJacobi()
+{
+    ThreadPool* pool = _lms.thread_pool();
+    const auto computeRange = [this](size_t begin, size_t end) {
+        distancePackets(begin, end);
+        for (size_t p = begin; p < end; p++)
         {
-            posInit[indexPoint[0]],
-            posInit[indexPoint[1]],
-            posInit[indexPoint[2]]
+            const EdgePacket& packet = edgePackets[p];
+            const EdgeOffsets& offset = edgePacketOffsets[p];
+            for (size_t lane = 0; lane < packet.lanes; lane++)
+            {
+                for (size_t i = 0; i < 2; i++)
+                {
+                    edgeOffset[2 * packet.edge[lane] + i] = math::vec3(offset.x[i][lane], offset.y[i][lane], offset.z[i][lane]);
+                }
+            }
         }
     };
-    float invTotalMass = 1.f / (mass[indexPoint[0]] + mass[indexPoint[1]] + mass[indexPoint[2]]);
-    math::vec3 cm[2];
-    math::vec3 axis[2][2];
-    float coord2D[2][3][2]; // initial/current | point | u/v
-    for (size_t n = 0; n < 2; n++)
-    {
-        math::vec3 side[] = {vec[n][1] - vec[n][0], vec[n][2] - vec[n][0]};
-        math::vec3 normal = math::vec3::cross(side[0], side[1]).normalized();
-        axis[n][0] = side[0].normalized();
-        axis[n][1] = math::vec3::cross(side[0], normal).normalized();
-        cm[n] = ((vec[n][0] * mass[indexPoint[0]]) + (vec[n][1] * mass[indexPoint[1]]) + (vec[n][2] * mass[indexPoint[2]])) * invTotalMass;
-        for (size_t i = 0; i < 3; i++)
+    const auto applyRange = [this](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; n++)
         {
-            coord2D[n][i][0] = math::vec3::dot(vec[n][i] - cm[n], axis[n][0]);
-            coord2D[n][i][1] = math::vec3::dot(vec[n][i] - cm[n], axis[n][1]);
+            math::vec3 offset(0.f, 0.f, 0.f);
+            for (size_t k = pointEdgeStart[n]; k < pointEdgeStart[n + 1]; k++)
+            {
+                offset += edgeOffset[pointEdgeSlot[k]];
+            }
+            _lms.move_linear_position(particles, n, offset);
+            positionScratch[n] += offset;
         }
-    }
-
-    for (size_t i = 0; i < 3; i++)
+    };
+    const size_t nbrOfPackets = edgePacketColourStart.back();
+    if (pool == nullptr || nbrOfEdges < PARALLEL_MIN_CONSTRAINTS)
     {
-        float length[2] = {
-            sqrt(coord2D[0][i][0] * coord2D[0][i][0] + coord2D[0][i][1] * coord2D[0][i][1]),
-            sqrt(coord2D[1][i][0] * coord2D[1][i][0] + coord2D[1][i][1] * coord2D[1][i][1])
-        };
-
-        float correctionFactor = ((length[1] - length[0]) / length[0]);
-        float correct2D[] = {
-            coord2D[0][i][0] * correctionFactor,
-            coord2D[0][i][1] * correctionFactor
-        };
-        math::vec3 correct3D = ((axis[0][0] * correct2D[0]) + (axis[0][1] * correct2D[1])) * triangleStiffness * invNbrAdjTriangles[indexPoint[i]];
-#ifdef UPDATE_ALL_AT_ONCE
-#ifdef USE_IMPULSE
-      correction[indexPoint[i]] += correct3D * INV_PHYSICS_TIME_STEP * mass[indexPoint[i]];
-#else
-      correction[indexPoint[i]] += correct3D;
-#endif
-#else
-#ifdef USE_IMPULSE
-        math::vec3 I = correct3D * INV_PHYSICS_TIME_STEP * mass[indexPoint[i]];
-        _lms.apply_impulse(posCur[indexPoint[i]], I);
-#else
-      _lms.move_linear_position(posCur[indexPoint[i]], correct3D);
-#endif
-#endif
+        computeRange(0, nbrOfPackets);
+        applyRange(0, nbrOfPoints);
+        return;
     }
+    pool->parallel_for(nbrOfPackets, PARALLEL_GRAIN_PACKETS, computeRange);
+    pool->parallel_for(nbrOfPoints, PARALLEL_GRAIN_CONSTRAINTS, applyRange);
 }
 
-void Cloth::edgeCorrection(size_t iEdge)
+void Cloth::applyRegionShapeMatching(size_t iRegion)
 {
-    size_t indexPoint[] = {
-        edges[2 * iEdge],
-        edges[2 * iEdge + 1]
-    };
-    float _mass[] = {
-        mass[indexPoint[0]],
-        mass[indexPoint[1]]
-    };
-    math::vec3 cur_pos[] = {
-        _lms.get_linear_position(posCur[indexPoint[0]]),
-        _lms.get_linear_position(posCur[indexPoint[1]])
-    };
-    math::vec3 ini_pos[] = {
-        posInit[indexPoint[0]],
-        posInit[indexPoint[1]]
-    };
-    math::vec3 cur_CM = (cur_pos[0] * mass[0] + cur_pos[1] * mass[1]) / (mass[0] + mass[1]);
-    math::vec3 ini_CM = (ini_pos[0] * mass[0] + ini_pos[1] * mass[1]) / (mass[0] + mass[1]);
+    const size_t first = regionStart[iRegion];
+    const size_t count = regionStart[iRegion + 1] - first;
+    const size_t* indexPoint = &regionMembers[first];
+    math::vec3* current = regionScratch.data();
+    _lms.gather_linear_positions(particles, indexPoint, count, current);
 
-    math::vec3 axis = (cur_pos[1] - cur_pos[0]).normalized();
-    math::vec3 goal[] = {
-        cur_CM - (axis * (ini_pos[0] - ini_CM).length()),
-        cur_CM + (axis * (ini_pos[1] - ini_CM).length())
-    };
+    math::vec3a cm;
+    for (size_t k = 0; k < count; k++) cm += math::vec3a(current[k]) * mass[indexPoint[k]];
+    cm *= regionInvMass[iRegion];
 
-    math::vec3 offset[] = {
-        (goal[0] - cur_pos[0]) * invNbrAdjEdges[indexPoint[0]] * edgeStiffness,
-        (goal[1] - cur_pos[1]) * invNbrAdjEdges[indexPoint[1]] * edgeStiffness
-    };
+    math::mat3 apq; // <- sum of m * (x_i - cm) * q_i^T, q_i being the rest offset
+    for (size_t k = 0; k < count; k++)
+    {
+        const math::vec3 p = (math::vec3a(current[k]) - cm).to_vec3() * mass[indexPoint[k]];
+        const math::vec3& q = regionRest[first + k];
+        const float pRow[] = { p.x, p.y, p.z };
+        for (int row = 0; row < 3; row++)
+        {
+            apq[row][0] += pRow[row] * q.x;
+            apq[row][1] += pRow[row] * q.y;
+            apq[row][2] += pRow[row] * q.z;
+        }
+    }
+    regionRotation[iRegion] = math::quat::extractRotation(apq, regionRotation[iRegion], REGION_ROTATION_ITERATIONS);
+    const math::mat3 rotation = regionRotation[iRegion].toMat3();
 
-    for (size_t i = 0; i < 2; i++)
+    for (size_t k = 0; k < count; k++)
     {
-#ifdef UPDATE_ALL_AT_ONCE
-#ifdef USE_IMPULSE
-      correction[indexPoint[i]] += offset[i] * INV_PHYSICS_TIME_STEP * mass[indexPoint[i]];
-#else
-      correction[indexPoint[i]] += offset[i];
-#endif
-#else
-#ifdef USE_IMPULSE
-        math::vec3 I = offset[i] * INV_PHYSICS_TIME_STEP * mass[indexPoint[i]];
-        _lms.apply_impulse(posCur[indexPoint[i]], I);
-#else
-      _lms.move_linear_position(posCur[indexPoint[i]], offset[i]);
-#endif
-#endif
+        const math::vec3a goal = cm + math::vec3a(rotation * regionRest[first + k]);
+        const math::vec3 correct = ((goal - math::vec3a(current[k])) * (regionStiffness * regionWeight[first + k])).to_vec3();
+        _lms.move_linear_position(particles, indexPoint[k], correct);
     }
 }
 
-void Cloth::update()
+void Cloth::update(float dt)
 {
-#ifdef UPDATE_ALL_AT_ONCE
-    memset(correction, 0, nbrOfPoints * sizeof(math::vec3));
-#endif
-    for (size_t n = 0; n < nbrOfPoints; n++)
+    if (sleeping)
+    {
+        if (_lms.is_at_rest(particles))
+        {
+            return;
+        }
+        wake(); // <- something pushed the cloth since it fell asleep
+    }
+
+    const float invDt = 1.f / dt;
+    if (model == ConstraintModel::XPBD) // <- the multipliers start over every step
     {
-        _lms.add_force(posCur[n], math::vec3(0.f, -9.81f, 0.f));
+        stepInvDt2 = invDt * invDt;
+        memset(triangleLambdas.get(), 0, packetColourStart.back() * sizeof(TriangleLambdas));
+        memset(edgeLambdas.get(), 0, edgePacketColourStart.back() * sizeof(EdgeLambdas));
     }
+    _lms.add_force(particles, math::vec3(0.f, -9.81f, 0.f));
 
-    // const std::array<size_t, 2> fixed = {0, nbrOfPoints - 1};
-    const std::array<size_t, 4> fixed = {0, width - 1, nbrOfPoints - 1};
-    for (const auto& a : fixed)
+    for (const auto& a : fixedPoints)
     {
 #ifdef USE_IMPULSE_TO_FIX_POINTS
-        math::vec3 Ia = math::vec3(posInit[a] - _lms.get_linear_position(posCur[a])) * INV_PHYSICS_TIME_STEP * mass[a];
-        _lms.apply_impulse(posCur[a], Ia);
+        math::vec3 Ia = math::vec3(posInit[a] - _lms.get_linear_position(particles, a)) * invDt * mass[a];
+        _lms.apply_impulse(particles, a, Ia);
 #else
-      _lms.move_linear_position(posCur[a], (posInit[a] - _lms.get_linear_position(posCur[a])) * PHYSICS_DAMPING_FACTOR);
+      _lms.move_linear_position(particles, a, (posInit[a] - _lms.get_linear_position(particles, a)) * PHYSICS_DAMPING_FACTOR);
 #endif
     }
 
-    for (size_t n = 0; n < nbrOfTriangles; n++)
+    if (regionStiffness > 0.f)
     {
-        triangle2DCorrection(n);
-        //applyTriangleShapeMatching(n);
+        for (int level = regionLevels; level > 0; level--) // <- coarse to fine, each level refines what the coarser moved
+        {
+            for (size_t n = levelStart[level - 1]; n < levelStart[level]; n++)
+            {
+                applyRegionShapeMatching(n);
+            }
+        }
     }
-    for (size_t n = 0; n < nbrOfEdges; n++)
+    if (solver == ConstraintSolver::JACOBI)
     {
-        //edgeCorrection(n); // use 2D rotation instead?
+        solveTrianglesJacobi();
     }
-#ifdef UPDATE_ALL_AT_ONCE
-    for (size_t n = 0; n < nbrOfPoints; n++)
+    else
     {
-#ifdef USE_IMPULSE
-      _lms.apply_impulse(posCur[n], correction[n]);
-#else
-      _lms.move_linear_position(posCur[n], correction[n]);
-#endif
+        solveTrianglesByColour();
+    }
+    if (solvesEdges()) // <- reads positionScratch as the triangle solvers leave it
+    {
+        if (solver == ConstraintSolver::JACOBI)
+        {
+            solveEdgesJacobi();
+        }
+        else
+        {
+            solveEdgesByColour();
+        }
+    }
+
+    // The velocities are no good measure of rest: the correction impulses keep them high while the positions do not
+    // move. The kinetic energy is computed instead from the displacement over the whole window.
+    windowTime += dt;
+    if (windowTime >= PHYSICS_SLEEP_DELAY)
+    {
+        float energy = 0.f;
+        for (size_t n = 0; n < nbrOfPoints; n++)
+        {
+            const math::vec3 p = _lms.get_linear_position(particles, n);
+            const math::vec3 v = (p - windowStart[n]) / windowTime;
+            energy += .5f * mass[n] * math::vec3::dot(v, v);
+            windowStart[n] = p;
+        }
+        windowTime = 0.f;
+        if (energy < .5f * PHYSICS_SLEEP_SPEED * PHYSICS_SLEEP_SPEED * totalMass)
+        {
+            sleep();
+        }
+    }
+}
+
+void Cloth::sleep()
+{
+    if (!sleeping)
+    {
+        _lms.stop_linear_update(particles);
+        _lms.clear_linear_motion(particles); // <- a disturbance is then any velocity or force showing up
+        sleeping = true;
+    }
+}
+
+void Cloth::wake()
+{
+    if (sleeping)
+    {
+        _lms.resume_linear_update(particles);
+        sleeping = false;
+        windowTime = 0.f;
     }
-#endif
 }
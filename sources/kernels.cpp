@@ -0,0 +1,63 @@
+#include "maths/vector_kernels.h"
+#include "physics/edge_kernels.h"
+#include "physics/linear_kernels.h"
+#include "physics/triangle_kernels.h"
+
+// Baseline translation unit: built with the default flags, it holds the kernel tables every x86-64 CPU runs. The wider
+// ones live in kernels_avx2.cpp and kernels_avx512.cpp, select_kernels() picks one of them at runtime.
+
+template <>
+const math::Vec3DKernels& kernels_for<math::Vec3DKernels, float>()
+{
+    static constexpr math::Vec3DKernels kernels = math::vec3d_kernels::make<float>();
+    return kernels;
+}
+
+template <>
+const math::Vec3DKernels& kernels_for<math::Vec3DKernels, __m128>()
+{
+    static constexpr math::Vec3DKernels kernels = math::vec3d_kernels::make<__m128>();
+    return kernels;
+}
+
+template <>
+const LinearKernels& kernels_for<LinearKernels, float>()
+{
+    static constexpr LinearKernels kernels{ &integrate_linear_lanes<float> };
+    return kernels;
+}
+
+template <>
+const LinearKernels& kernels_for<LinearKernels, __m128>()
+{
+    static constexpr LinearKernels kernels{ &integrate_linear_lanes<__m128> };
+    return kernels;
+}
+
+template <>
+const TriangleKernels& kernels_for<TriangleKernels, float>()
+{
+    static constexpr TriangleKernels kernels = triangle_kernels::make<float>();
+    return kernels;
+}
+
+template <>
+const TriangleKernels& kernels_for<TriangleKernels, __m128>()
+{
+    static constexpr TriangleKernels kernels = triangle_kernels::make<__m128>();
+    return kernels;
+}
+
+template <>
+const EdgeKernels& kernels_for<EdgeKernels, float>()
+{
+    static constexpr EdgeKernels kernels = edge_kernels::make<float>();
+    return kernels;
+}
+
+template <>
+const EdgeKernels& kernels_for<EdgeKernels, __m128>()
+{
+    static constexpr EdgeKernels kernels = edge_kernels::make<__m128>();
+    return kernels;
+}
@@ -0,0 +1,38 @@
+#include "maths/vector_kernels.h"
+#include "physics/edge_kernels.h"
+#include "physics/linear_kernels.h"
+#include "physics/triangle_kernels.h"
+
+// Built with -mavx2 -mfma (/arch:AVX2 with MSVC), see meson.build. Only called once get_cpu_simd_type() has confirmed
+// that the CPU supports it.
+#if !defined(__AVX2__)
+    #error "kernels_avx2.cpp has to be compiled for avx2"
+#endif
+
+template <>
+const math::Vec3DKernels& kernels_for<math::Vec3DKernels, __m256>()
+{
+    static constexpr math::Vec3DKernels kernels = math::vec3d_kernels::make<__m256>();
+    return kernels;
+}
+
+template <>
+const LinearKernels& kernels_for<LinearKernels, __m256>()
+{
+    static constexpr LinearKernels kernels{ &integrate_linear_lanes<__m256> };
+    return kernels;
+}
+
+template <>
+const TriangleKernels& kernels_for<TriangleKernels, __m256>()
+{
+    static constexpr TriangleKernels kernels = triangle_kernels::make<__m256>();
+    return kernels;
+}
+
+template <>
+const EdgeKernels& kernels_for<EdgeKernels, __m256>()
+{
+    static constexpr EdgeKernels kernels = edge_kernels::make<__m256>();
+    return kernels;
+}
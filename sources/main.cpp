@@ -6,6 +6,11 @@
 #include "3D/grid.h"
 #include "3D/graphics.h"
 #include "tools/config.h"
+#include "tools/thread_pool.h"
+#include "physics/time_step_controller.h"
+
+#include <atomic>
+#include <thread>
 
 std::chrono::high_resolution_clock::time_point last_update;
 float update_time_correction = 0.f;
@@ -16,7 +21,7 @@ float update_time_correction = 0.f;
 
 #define COLLISION
 
-LinearMotionSystem lms(10000);
+LinearMotionSystem lms;
 
 double timerClothUpdate(0);
 double minTm(1000000);
@@ -34,6 +39,23 @@ int main()
         exit(EXIT_FAILURE);
     }
 
+    const std::string simd = Config::get_instance()->get("physics", "simd", "auto"); // <- any other value keeps the CPU default
+    for (const SIMD_TYPE type : { SIMD_TYPE::NONE, SIMD_TYPE::SIMD_128, SIMD_TYPE::SIMD_256, SIMD_TYPE::SIMD_512 })
+    {
+        if (simd == to_string(type))
+        {
+            set_runtime_simd_type(type);
+        }
+    }
+
+    if (Config::get_instance()->get_int("physics", "fast_normalize", 0) != 0)
+    {
+        math::set_normalize_mode(math::NormalizeMode::FAST);
+    }
+
+    ThreadPool physicsWorkers(std::max(0, Config::get_instance()->get_int("physics", "threads", 0)));
+    lms.set_thread_pool(&physicsWorkers);
+
     auto graphics = GraphicsSystem::get_instance();
     if (!graphics->init())
     {
@@ -64,6 +86,20 @@ int main()
     cloth->setColor(1.f, 1.f, 1.f, .5f);
     cloth->setDensity(1.f);
     cloth->setStiffness(1.f, 1.f);
+    cloth->setRegionStiffness(static_cast<float>(Config::get_instance()->get_double("physics", "region_stiffness", 0.)));
+    cloth->setRegionLevels(Config::get_instance()->get_int("physics", "region_levels", 3));
+    if (Config::get_instance()->get("physics", "constraint_solver", "gauss_seidel") == "jacobi")
+    {
+        cloth->setConstraintSolver(ConstraintSolver::JACOBI);
+    }
+    cloth->setSolverIterations(Config::get_instance()->get_int("physics", "solver_iterations", 1));
+    cloth->setChebyshevRho(static_cast<float>(Config::get_instance()->get_double("physics", "chebyshev_rho", 0.)));
+    if (Config::get_instance()->get("physics", "constraint_model", "pbd") == "xpbd")
+    {
+        cloth->setConstraintModel(ConstraintModel::XPBD);
+    }
+    cloth->setCompliance(static_cast<float>(Config::get_instance()->get_double("physics", "triangle_compliance", 0.)),
+                         static_cast<float>(Config::get_instance()->get_double("physics", "edge_compliance", 0.)));
     cloth->setThickness(CLOTH_THICKNESS);
     cloth->initGL(uniformColorProgram, strainColorProgram);
     graphics->add_to_scene(cloth);
@@ -76,55 +112,100 @@ int main()
     graphics->add_to_scene(cloth);
 #endif
 
-    last_update = std::chrono::high_resolution_clock::now();
-
-    while (!graphics->should_close())
+    const auto config = Config::get_instance();
+    const float fixedStep = static_cast<float>(config->get_double("physics", "time_step", PHYSICS_TIME_STEP));
+    const bool adaptiveStep = config->get_int("physics", "adaptive_time_step", 0) != 0;
+    const int substeps = std::max(1, config->get_int("physics", "substeps", 1));
+    TimeStepController timeStep(std::min(CLOTH_EDGE_SIZE, CLOTH_THICKNESS),
+                                static_cast<float>(config->get_double("physics", "min_time_step", fixedStep)),
+                                static_cast<float>(config->get_double("physics", "max_time_step", fixedStep)),
+                                static_cast<float>(config->get_double("physics", "cfl", .5)));
+
+    // Physics runs on its own thread and publishes a snapshot of the scene after each batch of substeps, the render
+    // loop below only ever reads the latest snapshot, so neither side waits on the other.
+    std::atomic<bool> simulationRunning{ true };
+    std::thread physicsThread([&]()
     {
+        last_update = std::chrono::high_resolution_clock::now();
 
-        std::chrono::high_resolution_clock::time_point beginning_current_update = std::chrono::high_resolution_clock::now();
-        float elapsed_seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(beginning_current_update - last_update)
-            .count() * (float)1e-9 + update_time_correction;
-        int nbrOfUpdates = (int)(elapsed_seconds / PHYSICS_TIME_STEP);
-
-        // double tmClothUpdate(0.f);
-        double tmClothCollision(0.f);
-        for (int n = 0; n < nbrOfUpdates; n++)
+        while (simulationRunning.load(std::memory_order_acquire))
         {
-            lms.update_data();
-            auto t1 = std::chrono::high_resolution_clock::now();
-            cloth->update();
-            double tmp = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                std::chrono::high_resolution_clock::now() - t1).count() * 1e-9;
-            //tmClothUpdate += tmp / (double) nbrOfUpdates;
-            timerClothUpdate += tmp;
-            nbrOfFrames++;
-
-            if (tmp > maxTm) maxTm = tmp;
-            else if (tmp < minTm) minTm = tmp;
+            std::chrono::high_resolution_clock::time_point beginning_current_update = std::chrono::high_resolution_clock::now();
+            float elapsed_seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(beginning_current_update - last_update)
+                .count() * (float)1e-9 + update_time_correction;
+
+            // double tmClothUpdate(0.f);
+            double tmClothCollision(0.f);
+            int nbrOfUpdates = 0;
+            float dt = adaptiveStep ? timeStep.current() : fixedStep;
+            while (elapsed_seconds >= dt)
+            {
+                const float substep = dt / static_cast<float>(substeps);
+                double tmp = 0.;
+                for (int n = 0; n < substeps; n++) // <- the contacts are resolved every substep, with its own dt
+                {
+                    lms.update_data(substep);
+                    auto t1 = std::chrono::high_resolution_clock::now();
+                    cloth->update(substep);
+                    tmp += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::high_resolution_clock::now() - t1).count() * 1e-9;
+#ifdef COLLISION
+                    auto t2 = std::chrono::high_resolution_clock::now();
+                    clothCollisionModel->resolveInternalCollisions(substep);
+                    tmClothCollision += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::high_resolution_clock::now() - t2).count() * 1e-9;
+#endif
+                }
+                //tmClothUpdate += tmp / (double) nbrOfUpdates;
+                timerClothUpdate += tmp;
+                nbrOfFrames++;
+
+                if (tmp > maxTm) maxTm = tmp;
+                else if (tmp < minTm) minTm = tmp;
+                elapsed_seconds -= dt;
+                nbrOfUpdates++;
+                if (adaptiveStep)
+                {
+                    dt = timeStep.next(lms.max_linear_speed());
+                }
+            }
+            update_time_correction = elapsed_seconds;
+            if (nbrOfUpdates > 0)
+            {
+                tmClothCollision /= (double)nbrOfUpdates;
+                cloth->publish();
 #ifdef COLLISION
-            auto t2 = std::chrono::high_resolution_clock::now();
-            clothCollisionModel->resolveInternalCollisions();
-            tmClothCollision += std::chrono::duration_cast<std::chrono::nanoseconds>(
-                std::chrono::high_resolution_clock::now() - t2).count() * 1e-9 / (double)nbrOfUpdates;
+                clothCollisionModel->publish();
 #endif
+            }
+            else // <- ahead of real time, wait for the next step to be due
+            {
+                std::this_thread::sleep_for(std::chrono::duration<float>(dt - elapsed_seconds));
+            }
+
+            //timerClothUpdate += tmClothUpdate;
+            //nbrOfFrames++;
+
+            auto avgClothUpdateTime = nbrOfFrames > 0
+                                          ? timerClothUpdate / static_cast<double>(nbrOfFrames)
+                                          : 0.0;
+            // std::cout << avgClothUpdateTime << " over " << nbrOfFrames << " (min: " << minTm << " - max: "
+            //     << maxTm << " )" << std::endl;
+
+            last_update = beginning_current_update;
         }
-        update_time_correction = (elapsed_seconds - (nbrOfUpdates * PHYSICS_TIME_STEP));
-
-        //timerClothUpdate += tmClothUpdate;
-        //nbrOfFrames++;
-
-        auto avgClothUpdateTime = nbrOfFrames > 0
-                                      ? timerClothUpdate / static_cast<double>(nbrOfFrames)
-                                      : 0.0;
-        // std::cout << avgClothUpdateTime << " over " << nbrOfFrames << " (min: " << minTm << " - max: "
-        //     << maxTm << " )" << std::endl;
-
-        last_update = beginning_current_update;
+    });
 
+    while (!graphics->should_close())
+    {
         graphics->update();
     }
 
+    simulationRunning.store(false, std::memory_order_release);
+    physicsThread.join();
+
     graphics->release();
+    lms.set_thread_pool(nullptr);
 
     exit(EXIT_SUCCESS);
 }
@@ -1,6 +1,7 @@
 #include "maths/math.h"
 #include "macro.h"
 
+#include <cmath>
 #include <cstring>
 
 using namespace math;
@@ -45,7 +46,7 @@ quat quat::operator-() const
 quat quat::operator*(float s) const
 {
     DBG_VALID_FLOAT(s);
-    return quat(w * s, x * s, y * z, z * s);
+    return quat(w * s, x * s, y * s, z * s);
 }
 
 quat quat::operator*(const quat& q2) const
@@ -77,6 +78,33 @@ bool quat::operator!=(const quat& q2) const
     return !(*this == q2);
 }
 
+float quat::norm() const
+{
+    return sqrt(w * w + x * x + y * y + z * z);
+}
+
+quat quat::normalized() const
+{
+    DBG_ASSERT(norm() != 0.f);
+    const float invNorm = 1.f / norm();
+    return quat(w * invNorm, x * invNorm, y * invNorm, z * invNorm);
+}
+
+mat3 quat::toMat3() const
+{
+    mat3 m;
+    m.data[0] = 1.f - 2.f * (y * y + z * z);
+    m.data[1] = 2.f * (x * y - w * z);
+    m.data[2] = 2.f * (x * z + w * y);
+    m.data[3] = 2.f * (x * y + w * z);
+    m.data[4] = 1.f - 2.f * (x * x + z * z);
+    m.data[5] = 2.f * (y * z - w * x);
+    m.data[6] = 2.f * (x * z - w * y);
+    m.data[7] = 2.f * (y * z + w * x);
+    m.data[8] = 1.f - 2.f * (x * x + y * y);
+    return m;
+}
+
 quat quat::R_quat(float radian, const vec3& axis)
 {
     DBG_VALID_FLOAT(radian);
@@ -129,6 +157,32 @@ quat quat::extractQuat(const mat& m)
     return q;
 }
 
+quat quat::extractRotation(const mat3& a, const quat& warmStart, int maxIterations)
+{
+    quat q = warmStart;
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        const mat3 r = q.toMat3();
+        vec3 torque(0.f, 0.f, 0.f);
+        float alignment = 0.f;
+        for (int col = 0; col < 3; col++)
+        {
+            const vec3 rCol(r.data[col], r.data[3 + col], r.data[6 + col]);
+            const vec3 aCol(a.data[col], a.data[3 + col], a.data[6 + col]);
+            torque += vec3::cross(rCol, aCol);
+            alignment += vec3::dot(rCol, aCol);
+        }
+        const vec3 omega = torque * (1.f / (std::fabs(alignment) + 1e-9f));
+        const float angle = omega.length();
+        if (!(angle >= 1e-6f) || !std::isfinite(angle)) // <- converged to float precision, or `a` is degenerate
+        {
+            break;
+        }
+        q = (R_quat(angle, omega / angle) * q).normalized();
+    }
+    return q;
+}
+
 quat quat::slerp(const quat& q1, const quat& q2, float alpha)
 {
     DBG_VALID_FLOAT(alpha);
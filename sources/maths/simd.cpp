@@ -0,0 +1,98 @@
+#include "maths/simd.h"
+
+#include <atomic>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+namespace
+{
+    SIMD_TYPE detect_cpu_simd_type()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse = (info[3] & (1 << 25)) != 0;
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+
+        bool avx2 = false;
+        bool avx512f = false;
+        if (maxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+            avx512f = (info[1] & (1 << 16)) != 0;
+        }
+
+        // the OS has to save the wider registers on context switches too
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        const bool osAvx = (xcr0 & 0x06) == 0x06;    // xmm, ymm
+        const bool osAvx512 = (xcr0 & 0xe6) == 0xe6; // xmm, ymm, opmask, zmm
+
+        if (avx512f && osAvx512)
+        {
+            return SIMD_TYPE::SIMD_512;
+        }
+        if (avx && avx2 && fma && osAvx)
+        {
+            return SIMD_TYPE::SIMD_256;
+        }
+        return sse ? SIMD_TYPE::SIMD_128 : SIMD_TYPE::NONE;
+#else
+        __builtin_cpu_init(); // <- the checks below include the OS support of the registers
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            return SIMD_TYPE::SIMD_512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return SIMD_TYPE::SIMD_256;
+        }
+        return __builtin_cpu_supports("sse") ? SIMD_TYPE::SIMD_128 : SIMD_TYPE::NONE;
+#endif
+    }
+
+    std::atomic<SIMD_TYPE>& runtime_simd_type()
+    {
+        static std::atomic<SIMD_TYPE> type{ get_cpu_simd_type() };
+        return type;
+    }
+}
+
+SIMD_TYPE get_cpu_simd_type()
+{
+    static const SIMD_TYPE type = detect_cpu_simd_type();
+    return type;
+}
+
+SIMD_TYPE get_runtime_simd_type()
+{
+    return runtime_simd_type().load(std::memory_order_relaxed);
+}
+
+SIMD_TYPE set_runtime_simd_type(SIMD_TYPE type)
+{
+    if (static_cast<int>(type) > static_cast<int>(get_cpu_simd_type()))
+    {
+        type = get_cpu_simd_type();
+    }
+    runtime_simd_type().store(type, std::memory_order_relaxed);
+    return type;
+}
+
+const char* to_string(SIMD_TYPE type)
+{
+    switch (type)
+    {
+        case SIMD_TYPE::SIMD_128: return "sse";
+        case SIMD_TYPE::SIMD_256: return "avx2";
+        case SIMD_TYPE::SIMD_512: return "avx512";
+        default:                  return "scalar";
+    }
+}
@@ -1,6 +1,8 @@
 #include "maths/math.h"
+#include "maths/vector_kernels.h"
 #include "macro.h"
 
+#include <atomic>
 #include <cstring>
 
 using namespace math;
@@ -92,6 +94,16 @@ vec3 vec3::normalized() const
     return *this / length();
 }
 
+float vec3::fast_length() const
+{
+    return vec3a(*this).fast_length();
+}
+
+vec3 vec3::fast_normalized() const
+{
+    return vec3a(*this).fast_normalized().to_vec3();
+}
+
 float vec3::dot(const vec3& v1, const vec3& v2)
 {
     DBG_VALID_VEC(v1);
@@ -112,4 +124,77 @@ vec3 vec3::cross(const vec3& v1, const vec3& v2)
 vec3 math::operator*(const float scalar, const vec3& v)
 {
     return v * scalar;
-}
\ No newline at end of file
+}
+
+namespace
+{
+    std::atomic<NormalizeMode> normalizeMode{ NormalizeMode::EXACT };
+
+    Vec3D_lanes lanes_of(const Vec3D_simd& v)
+    {
+        return { v.x_data(), v.y_data(), v.z_data() };
+    }
+}
+
+void math::set_normalize_mode(NormalizeMode mode)
+{
+    normalizeMode.store(mode, std::memory_order_relaxed);
+}
+
+NormalizeMode math::get_normalize_mode()
+{
+    return normalizeMode.load(std::memory_order_relaxed);
+}
+
+void math::add_3D_vectors_simd(const Vec3D_simd& a, const Vec3D_simd& b, Vec3D_simd& result)
+{
+    const auto count = std::min({ a.size(), b.size(), result.size() });
+    select_kernels<Vec3DKernels>().add(lanes_of(a), lanes_of(b), lanes_of(result), count);
+}
+
+void math::sub_3D_vectors_simd(const Vec3D_simd& a, const Vec3D_simd& b, Vec3D_simd& result)
+{
+    const auto count = std::min({ a.size(), b.size(), result.size() });
+    select_kernels<Vec3DKernels>().sub(lanes_of(a), lanes_of(b), lanes_of(result), count);
+}
+
+void math::scale_3D_vectors_simd(const Vec3D_simd& a, float scalar, Vec3D_simd& result)
+{
+    DBG_VALID_FLOAT(scalar);
+    const auto count = std::min(a.size(), result.size());
+    select_kernels<Vec3DKernels>().scale(lanes_of(a), scalar, lanes_of(result), count);
+}
+
+void math::mul_add_3D_vectors_simd(const Vec3D_simd& a, float scalar, const Vec3D_simd& b, Vec3D_simd& result)
+{
+    DBG_VALID_FLOAT(scalar);
+    const auto count = std::min({ a.size(), b.size(), result.size() });
+    select_kernels<Vec3DKernels>().mul_add(lanes_of(a), scalar, lanes_of(b), lanes_of(result), count);
+}
+
+void math::cross_3D_vectors_simd(const Vec3D_simd& a, const Vec3D_simd& b, Vec3D_simd& result)
+{
+    const auto count = std::min({ a.size(), b.size(), result.size() });
+    select_kernels<Vec3DKernels>().cross(lanes_of(a), lanes_of(b), lanes_of(result), count);
+}
+
+void math::normalize_3D_vectors_simd(const Vec3D_simd& a, Vec3D_simd& result)
+{
+    const auto count = std::min(a.size(), result.size());
+    const Vec3DKernels& kernels = select_kernels<Vec3DKernels>();
+    (get_normalize_mode() == NormalizeMode::FAST ? kernels.fast_normalize : kernels.normalize)(lanes_of(a), lanes_of(result), count);
+}
+
+void math::length_3D_vectors_simd(const Vec3D_simd& a, float* result)
+{
+    DBG_ASSERT(reinterpret_cast<uintptr_t>(result) % SIMD_MAX_ALIGNMENT == 0);
+    const Vec3DKernels& kernels = select_kernels<Vec3DKernels>();
+    (get_normalize_mode() == NormalizeMode::FAST ? kernels.fast_length : kernels.length)(lanes_of(a), result, a.size());
+}
+
+void math::dot_3D_vectors_simd(const Vec3D_simd& a, const Vec3D_simd& b, float* result)
+{
+    DBG_ASSERT(reinterpret_cast<uintptr_t>(result) % SIMD_MAX_ALIGNMENT == 0);
+    const auto count = std::min(a.size(), b.size());
+    select_kernels<Vec3DKernels>().dot(lanes_of(a), lanes_of(b), result, count);
+}
@@ -7,95 +7,93 @@
 
 AngularMotionSystem::AngularMotionSystem(size_t size)
     : size{ size }
-    , firstAvailable{ 0u }
+    , slots{ size }
     , angularDataPool{ std::make_unique<AngularData[]>(size) }
     , angularDataUsed{ std::make_unique<bool[]>(size) }
     , angularDataSkip{ std::make_unique<bool[]>(size) }
 { }
 
-size_t AngularMotionSystem::new_angular_data(const math::quat& position, const math::quat& velocity, const math::mat& inertiaMatrix)
+AngularHandle AngularMotionSystem::new_angular_data(const math::quat& position, const math::quat& velocity, const math::mat& inertiaMatrix)
 {
-    for (size_t n = this->firstAvailable; n < this->size; n++)
+    const AngularHandle h = slots.allocate();
+    if (!h.is_null())
     {
-        if (!angularDataUsed[n])
-        {
-            this->firstAvailable = n + 1;
-            angularDataUsed[n] = true;
-            angularDataPool[n].p = position;
-            angularDataPool[n].v = velocity;
-            angularDataPool[n].I = inertiaMatrix;
-            return n;
-        }
+        const size_t n = h.index();
+        angularDataUsed[n] = true;
+        angularDataPool[n].p = position;
+        angularDataPool[n].v = velocity;
+        angularDataPool[n].t = math::vec3();
+        angularDataPool[n].I = inertiaMatrix;
     }
-    return -1;
+    return h;
 }
 
-void AngularMotionSystem::free_angular_data(size_t i)
+void AngularMotionSystem::free_angular_data(AngularHandle h)
 {
-    DBG_ASSERT(i < this->size);
-    DBG_ASSERT(angularDataUsed[i]);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size)
+    if (slots.release(h))
     {
-        angularDataUsed[i] = false;
-        angularDataSkip[i] = false;
-        if (i < this->firstAvailable)
-        {
-            this->firstAvailable = i;
-        }
+        angularDataUsed[h.index()] = false;
+        angularDataSkip[h.index()] = false;
     }
 }
 
-void AngularMotionSystem::stop_angular_update(size_t i)
+void AngularMotionSystem::stop_angular_update(AngularHandle h)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size && angularDataUsed[i])
+    if (slots.is_valid(h))
     {
-        angularDataSkip[i] = true;
+        angularDataSkip[h.index()] = true;
     }
 }
 
-void AngularMotionSystem::resume_angular_update(size_t i)
+void AngularMotionSystem::resume_angular_update(AngularHandle h)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size)
+    if (slots.is_valid(h))
     {
-        angularDataSkip[i] = false;
+        angularDataSkip[h.index()] = false;
     }
 }
 
-math::quat AngularMotionSystem::get_angular_position(size_t i)
+bool AngularMotionSystem::is_valid(AngularHandle h) const
+{
+    return slots.is_valid(h);
+}
+
+math::quat AngularMotionSystem::get_angular_position(AngularHandle h)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size && angularDataUsed[i])
+    if (slots.is_valid(h))
     {
-        return angularDataPool[i].p;
+        return angularDataPool[h.index()].p;
     }
     return {};
 }
 
-void AngularMotionSystem::add_torque(size_t i, const math::vec3& torque)
+void AngularMotionSystem::add_torque(AngularHandle h, const math::vec3& torque)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
     DBG_VALID_VEC(torque);
 
-    if (i < this->size)
+    if (slots.is_valid(h))
     {
-        angularDataPool[i].t += torque;
+        angularDataPool[h.index()].t += torque;
     }
 }
 
-void AngularMotionSystem::set_inertia_matrix(size_t i, const math::mat& inertiaMatrix)
+void AngularMotionSystem::set_inertia_matrix(AngularHandle h, const math::mat& inertiaMatrix)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
     DBG_VALID_MAT(inertiaMatrix);
 
-    if (i < this->size)
+    if (slots.is_valid(h))
     {
-        angularDataPool[i].I = inertiaMatrix;
+        angularDataPool[h.index()].I = inertiaMatrix;
     }
 }
 
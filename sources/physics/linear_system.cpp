@@ -1,19 +1,73 @@
 #include "physics/linear_system.h"
 #include "physics/constants.h"
+#include "physics/linear_kernels.h"
+#include "tools/thread_pool.h"
 #include "macro.h"
 
+#include <cmath>
 #include <cstring>
 #include <exception>
 
-LinearMotionSystem::LinearMotionSystem(size_t size)
-    : size{ size }
-    , firstAvailable{ 0u }
-    , linearDataPool{ std::make_unique<LinearData[]>(size) }
-    , linearDataUsed{ std::make_unique<bool[]>(size) }
-    , linearDataSkip{ std::make_unique<bool[]>(size) }
-{ }
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
 
-size_t LinearMotionSystem::new_linear_data(const math::vec3& position, const math::vec3& velocity, const float mass)
+namespace
+{
+    size_t count_trailing_zeros(uint64_t word)
+    {
+        DBG_ASSERT(word != 0);
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return index;
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    // Power of two so that a slot index splits into chunk and local index with a shift and a mask, and at least one
+    // bitset word so that chunks never share a word.
+    size_t round_chunk_size(size_t size)
+    {
+        size_t rounded = 64;
+        while (rounded < size && rounded < SlotHandle::MAX_SLOTS / 2)
+        {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+}
+
+LinearMotionSystem::Chunk::Chunk(size_t size)
+    : positions{ size }
+    , velocities{ size }
+    , forces{ size }
+    , previousPositions{ Integrator::keeps_previous_position ? math::Vec3D_simd(size) : math::Vec3D_simd() }
+    , inverseMasses{ make_aligned_unique<float[]>(size, SIMD_MAX_ALIGNMENT) }
+    , usedMask{ std::make_unique<uint64_t[]>(size / BITS_PER_WORD) }
+    , activeMask{ std::make_unique<uint64_t[]>(size / BITS_PER_WORD) }
+{
+    std::fill(inverseMasses.get(), inverseMasses.get() + size, 0.f);
+}
+
+LinearMotionSystem::LinearMotionSystem(size_t chunkSize)
+    : chunkSize{ round_chunk_size(chunkSize) }
+    , chunkShift{ count_trailing_zeros(this->chunkSize) }
+    , slots{ 0u, this->chunkSize }
+{
+    DBG_ASSERT(chunkSize > 0 && chunkSize <= SlotHandle::MAX_SLOTS / 2);
+}
+
+void LinearMotionSystem::grow()
+{
+    DBG_ASSERT((chunks.size() + 1) * this->chunkSize <= SlotHandle::MAX_SLOTS);
+
+    chunks.push_back(std::make_unique<Chunk>(this->chunkSize));
+    slots.grow(this->chunkSize);
+}
+
+LinearHandle LinearMotionSystem::new_linear_data(const math::vec3& position, const math::vec3& velocity, const float mass)
 {
     DBG_VALID_VEC(position);
     DBG_VALID_VEC(velocity);
@@ -22,153 +76,693 @@ size_t LinearMotionSystem::new_linear_data(const math::vec3& position, const mat
 
     if (mass != 0)
     {
-        for (size_t n = this->firstAvailable; n < this->size; n++)
+        LinearHandle h = slots.allocate();
+        if (h.is_null() && (chunks.size() + 1) * this->chunkSize <= SlotHandle::MAX_SLOTS)
         {
-            if (!linearDataUsed[n])
-            {
-                this->firstAvailable = n + 1;
-                linearDataUsed[n] = true;
-                linearDataPool[n].p = position;
-                linearDataPool[n].v = velocity;
-                linearDataPool[n].im = 1 / mass;
-                return n;
-            }
+            grow();
+            h = slots.allocate();
         }
+        if (!h.is_null())
+        {
+            Chunk& c = chunk_of(h.index());
+            const size_t n = local_index(h.index());
+            mark_used(h.index());
+            c.positions.set(n, position);
+            c.velocities.set(n, velocity);
+            c.forces.set(n, math::vec3());
+            c.inverseMasses[n] = 1 / mass;
+            reset_previous_position(c, n);
+        }
+        return h;
     }
-    return -1;
+    return {};
 }
 
-void LinearMotionSystem::free_linear_data(size_t i)
+void LinearMotionSystem::free_linear_data(LinearHandle h)
 {
-    DBG_ASSERT(i < this->size);
-    DBG_ASSERT(linearDataUsed[i]);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size)
+    if (slots.release(h))
     {
-        linearDataUsed[i] = false;
-        linearDataSkip[i] = false;
-        if (i < this->firstAvailable)
-        {
-            this->firstAvailable = i;
-        }
+        mark_free(h.index());
     }
 }
 
-void LinearMotionSystem::stop_linear_update(size_t i)
+void LinearMotionSystem::stop_linear_update(LinearHandle h)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size && linearDataUsed[i])
+    if (slots.is_valid(h))
     {
-        linearDataSkip[i] = true;
+        const size_t n = local_index(h.index());
+        chunk_of(h.index()).activeMask[n / BITS_PER_WORD] &= ~(uint64_t{ 1 } << (n % BITS_PER_WORD));
     }
 }
 
-void LinearMotionSystem::resume_linear_update(size_t i)
+void LinearMotionSystem::resume_linear_update(LinearHandle h)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size)
+    if (slots.is_valid(h))
     {
-        linearDataSkip[i] = false;
+        const size_t n = local_index(h.index());
+        chunk_of(h.index()).activeMask[n / BITS_PER_WORD] |= uint64_t{ 1 } << (n % BITS_PER_WORD);
     }
 }
 
-math::vec3 LinearMotionSystem::get_linear_position(size_t i)
+bool LinearMotionSystem::is_valid(LinearHandle h) const
+{
+    return slots.is_valid(h);
+}
+
+math::vec3 LinearMotionSystem::get_linear_position(LinearHandle h)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size && linearDataUsed[i])
+    if (slots.is_valid(h))
     {
-        return linearDataPool[i].p;
+        return chunk_of(h.index()).positions.get(local_index(h.index()));
     }
     return {};
 }
 
-math::vec3 LinearMotionSystem::get_linear_velocity(size_t i)
+math::vec3 LinearMotionSystem::get_linear_velocity(LinearHandle h)
 {
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size && linearDataUsed[i])
+    if (slots.is_valid(h))
     {
-        return linearDataPool[i].v;
+        return chunk_of(h.index()).velocities.get(local_index(h.index()));
     }
     return {};
 }
 
-void LinearMotionSystem::move_linear_position(size_t i, const math::vec3& offset)
+void LinearMotionSystem::move_linear_position(LinearHandle h, const math::vec3& offset)
 {
     DBG_VALID_VEC(offset);
+    DBG_ASSERT(slots.is_valid(h));
 
-    DBG_ASSERT(i < this->size);
-    DBG_ASSERT(linearDataUsed[i]);
-
-    if (i < this->size)
+    if (slots.is_valid(h))
     {
-        linearDataPool[i].p += offset;
-        linearDataPool[i].v += offset / PHYSICS_TIME_STEP;
+        Chunk& c = chunk_of(h.index());
+        const size_t i = local_index(h.index());
+        c.positions.set(i, c.positions.get(i) + offset);
+        c.velocities.set(i, c.velocities.get(i) + offset / this->timeStep);
     }
 }
 
-void LinearMotionSystem::add_force(size_t i, const math::vec3& force)
+void LinearMotionSystem::add_force(LinearHandle h, const math::vec3& force)
 {
     DBG_VALID_VEC(force);
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
 
-    if (i < this->size)
+    if (slots.is_valid(h))
     {
-        linearDataPool[i].f += force;
+        Chunk& c = chunk_of(h.index());
+        const size_t i = local_index(h.index());
+        c.forces.set(i, c.forces.get(i) + force);
     }
 }
 
-void LinearMotionSystem::add_velocity(size_t i, const math::vec3& velocity)
+void LinearMotionSystem::add_velocity(LinearHandle h, const math::vec3& velocity)
 {
     DBG_VALID_VEC(velocity);
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(slots.is_valid(h));
+
+    if (slots.is_valid(h))
+    {
+        Chunk& c = chunk_of(h.index());
+        const size_t i = local_index(h.index());
+        add_to_velocity(c, i, velocity);
+    }
+}
+
+void LinearMotionSystem::apply_impulse(LinearHandle h, const math::vec3& impulse)
+{
+    DBG_VALID_VEC(impulse);
+    DBG_ASSERT(slots.is_valid(h));
+
+    if (slots.is_valid(h))
+    {
+        Chunk& c = chunk_of(h.index());
+        const size_t i = local_index(h.index());
+        add_to_velocity(c, i, impulse * c.inverseMasses[i]);
+    }
+}
+
+void LinearMotionSystem::set_mass(LinearHandle h, float mass)
+{
+    DBG_VALID_FLOAT(mass);
+    DBG_ASSERT(slots.is_valid(h));
+    DBG_ASSERT(mass != 0.f);
+
+    if (slots.is_valid(h) && mass != 0.f)
+    {
+        chunk_of(h.index()).inverseMasses[local_index(h.index())] = 1.f / mass;
+    }
+}
+
+LinearBlock LinearMotionSystem::new_linear_block(size_t count, const math::vec3* positions, const math::vec3* velocities, const float* masses)
+{
+    DBG_ASSERT(positions != nullptr && masses != nullptr);
+    DBG_ASSERT(count > 0 && count <= this->chunkSize);
+
+    LinearBlock block;
+    if (positions != nullptr && masses != nullptr && count > 0 && count <= this->chunkSize)
+    {
+        block.first = slots.allocate_range(count);
+        if (block.first.is_null() && (chunks.size() + 1) * this->chunkSize <= SlotHandle::MAX_SLOTS)
+        {
+            grow();
+            block.first = slots.allocate_range(count);
+        }
+        if (!block.first.is_null())
+        {
+            block.count = count;
+            Chunk& c = chunk_of(block.first.index());
+            const size_t first = local_index(block.first.index());
+            for (size_t n = 0; n < count; n++)
+            {
+                DBG_VALID_VEC(positions[n]);
+                DBG_VALID_FLOAT(masses[n]);
+                DBG_ASSERT(masses[n] != 0.f);
+                mark_used(block.first.index() + n);
+                c.positions.set(first + n, positions[n]);
+                c.velocities.set(first + n, velocities != nullptr ? velocities[n] : math::vec3());
+                c.forces.set(first + n, math::vec3());
+                c.inverseMasses[first + n] = 1.f / masses[n];
+                reset_previous_position(c, first + n);
+            }
+        }
+    }
+    return block;
+}
+
+void LinearMotionSystem::free_linear_block(const LinearBlock& block)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block) && slots.release_range(block.first, block.count))
+    {
+        for (size_t n = 0; n < block.count; n++)
+        {
+            mark_free(block.first.index() + n);
+        }
+    }
+}
+
+bool LinearMotionSystem::is_valid(const LinearBlock& block) const
+{
+    return block.count > 0 && slots.is_valid(block.first);
+}
+
+LinearHandle LinearMotionSystem::get_linear_handle(const LinearBlock& block, size_t offset) const
+{
+    DBG_ASSERT(is_valid(block) && offset < block.count);
+
+    if (is_valid(block) && offset < block.count)
+    {
+        return slots.handle_at(block.first.index() + offset);
+    }
+    return {};
+}
+
+math::vec3 LinearMotionSystem::get_linear_position(const LinearBlock& block, size_t offset)
+{
+    DBG_ASSERT(is_valid(block) && offset < block.count);
+
+    if (is_valid(block) && offset < block.count)
+    {
+        const size_t i = block.first.index() + offset;
+        return chunk_of(i).positions.get(local_index(i));
+    }
+    return {};
+}
+
+math::vec3 LinearMotionSystem::get_linear_velocity(const LinearBlock& block, size_t offset)
+{
+    DBG_ASSERT(is_valid(block) && offset < block.count);
 
-    if (i < this->size)
+    if (is_valid(block) && offset < block.count)
     {
-        linearDataPool[i].v += velocity;
+        const size_t i = block.first.index() + offset;
+        return chunk_of(i).velocities.get(local_index(i));
     }
+    return {};
 }
 
-void LinearMotionSystem::apply_impulse(size_t i, const math::vec3& impulse)
+void LinearMotionSystem::move_linear_position(const LinearBlock& block, size_t offset, const math::vec3& offsetPosition)
+{
+    DBG_VALID_VEC(offsetPosition);
+    DBG_ASSERT(is_valid(block) && offset < block.count);
+
+    if (is_valid(block) && offset < block.count)
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t i = local_index(block.first.index()) + offset;
+        c.positions.set(i, c.positions.get(i) + offsetPosition);
+        c.velocities.set(i, c.velocities.get(i) + offsetPosition / this->timeStep);
+    }
+}
+
+void LinearMotionSystem::add_force(const LinearBlock& block, size_t offset, const math::vec3& force)
+{
+    DBG_VALID_VEC(force);
+    DBG_ASSERT(is_valid(block) && offset < block.count);
+
+    if (is_valid(block) && offset < block.count)
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t i = local_index(block.first.index()) + offset;
+        c.forces.set(i, c.forces.get(i) + force);
+    }
+}
+
+void LinearMotionSystem::apply_impulse(const LinearBlock& block, size_t offset, const math::vec3& impulse)
 {
     DBG_VALID_VEC(impulse);
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(is_valid(block) && offset < block.count);
 
-    if (i < this->size)
+    if (is_valid(block) && offset < block.count)
     {
-        linearDataPool[i].v += impulse * linearDataPool[i].im;
+        Chunk& c = chunk_of(block.first.index());
+        const size_t i = local_index(block.first.index()) + offset;
+        add_to_velocity(c, i, impulse * c.inverseMasses[i]);
     }
 }
 
-void LinearMotionSystem::set_mass(size_t i, float mass)
+void LinearMotionSystem::set_mass(const LinearBlock& block, size_t offset, float mass)
 {
     DBG_VALID_FLOAT(mass);
-    DBG_ASSERT(i < this->size);
+    DBG_ASSERT(is_valid(block) && offset < block.count);
     DBG_ASSERT(mass != 0.f);
 
-    if (i < this->size && mass != 0.f)
+    if (is_valid(block) && offset < block.count && mass != 0.f)
+    {
+        const size_t i = block.first.index() + offset;
+        chunk_of(i).inverseMasses[local_index(i)] = 1.f / mass;
+    }
+}
+
+void LinearMotionSystem::stop_linear_update(const LinearBlock& block)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        set_active(block, false);
+    }
+}
+
+void LinearMotionSystem::resume_linear_update(const LinearBlock& block)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        set_active(block, true);
+    }
+}
+
+void LinearMotionSystem::clear_linear_motion(const LinearBlock& block)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        for (size_t n = first; n < first + block.count; n++)
+        {
+            c.velocities.set(n, math::vec3());
+            c.forces.set(n, math::vec3());
+            reset_previous_position(c, n);
+        }
+    }
+}
+
+bool LinearMotionSystem::is_at_rest(const LinearBlock& block) const
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        const Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        const float* data[] = {
+            c.velocities.x_data(), c.velocities.y_data(), c.velocities.z_data(),
+            c.forces.x_data(), c.forces.y_data(), c.forces.z_data()
+        };
+        for (const float* axis : data)
+        {
+            for (size_t n = first; n < first + block.count; n++)
+            {
+                if (axis[n] != 0.f)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void LinearMotionSystem::gather_linear_positions(const LinearBlock& block, const size_t* offsets, size_t count, math::vec3* positions)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        const Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        for (size_t n = 0; n < count; n++)
+        {
+            DBG_ASSERT(offsets[n] < block.count);
+            positions[n] = c.positions.get(first + offsets[n]);
+        }
+    }
+}
+
+void LinearMotionSystem::gather_linear_velocities(const LinearBlock& block, const size_t* offsets, size_t count, math::vec3* velocities)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        const Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        for (size_t n = 0; n < count; n++)
+        {
+            DBG_ASSERT(offsets[n] < block.count);
+            velocities[n] = c.velocities.get(first + offsets[n]);
+        }
+    }
+}
+
+void LinearMotionSystem::gather_linear_positions(const LinearBlock& block, math::vec3* positions)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        const Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        const float* px = c.positions.x_data() + first;
+        const float* py = c.positions.y_data() + first;
+        const float* pz = c.positions.z_data() + first;
+        for (size_t n = 0; n < block.count; n++)
+        {
+            positions[n] = math::vec3(px[n], py[n], pz[n]);
+        }
+    }
+}
+
+void LinearMotionSystem::scatter_impulses(const LinearBlock& block, const size_t* offsets, size_t count, const math::vec3* impulses)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        for (size_t n = 0; n < count; n++)
+        {
+            DBG_ASSERT(offsets[n] < block.count);
+            DBG_VALID_VEC(impulses[n]);
+            const size_t i = first + offsets[n];
+            add_to_velocity(c, i, impulses[n] * c.inverseMasses[i]);
+        }
+    }
+}
+
+void LinearMotionSystem::scatter_moves(const LinearBlock& block, const size_t* offsets, size_t count, const math::vec3* moves)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        float* p[3] = { c.positions.x_data(), c.positions.y_data(), c.positions.z_data() };
+        float* v[3] = { c.velocities.x_data(), c.velocities.y_data(), c.velocities.z_data() };
+        for (size_t n = 0; n < count; n++)
+        {
+            DBG_ASSERT(offsets[n] < block.count);
+            DBG_VALID_VEC(moves[n]);
+            const size_t i = first + offsets[n];
+            const float move[3] = { moves[n].x, moves[n].y, moves[n].z };
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                p[axis][i] += move[axis];
+                v[axis][i] += move[axis] / this->timeStep;
+            }
+        }
+    }
+}
+
+void LinearMotionSystem::apply_impulses(const LinearBlock& block, const math::vec3* impulses)
+{
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        for (size_t n = 0; n < block.count; n++)
+        {
+            DBG_VALID_VEC(impulses[n]);
+            add_to_velocity(c, first + n, impulses[n] * c.inverseMasses[first + n]);
+        }
+    }
+}
+
+void LinearMotionSystem::add_force(const LinearBlock& block, const math::vec3& force)
+{
+    DBG_VALID_VEC(force);
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        float* fx = c.forces.x_data() + first;
+        float* fy = c.forces.y_data() + first;
+        float* fz = c.forces.z_data() + first;
+        for (size_t n = 0; n < block.count; n++)
+        {
+            fx[n] += force.x;
+            fy[n] += force.y;
+            fz[n] += force.z;
+        }
+    }
+}
+
+void LinearMotionSystem::add_acceleration(const LinearBlock& block, const math::vec3& acceleration)
+{
+    DBG_VALID_VEC(acceleration);
+    DBG_ASSERT(is_valid(block));
+
+    if (is_valid(block))
+    {
+        Chunk& c = chunk_of(block.first.index());
+        const size_t first = local_index(block.first.index());
+        float* fx = c.forces.x_data() + first;
+        float* fy = c.forces.y_data() + first;
+        float* fz = c.forces.z_data() + first;
+        const float* im = c.inverseMasses.get() + first;
+        for (size_t n = 0; n < block.count; n++) // <- f = m * a
+        {
+            fx[n] += acceleration.x / im[n];
+            fy[n] += acceleration.y / im[n];
+            fz[n] += acceleration.z / im[n];
+        }
+    }
+}
+
+void LinearMotionSystem::mark_used(size_t i)
+{
+    Chunk& c = chunk_of(i);
+    const size_t n = local_index(i);
+    const uint64_t bit = uint64_t{ 1 } << (n % BITS_PER_WORD);
+    c.wordEnd = std::max(c.wordEnd, n / BITS_PER_WORD + 1);
+    c.usedMask[n / BITS_PER_WORD] |= bit;
+    c.activeMask[n / BITS_PER_WORD] |= bit;
+}
+
+void LinearMotionSystem::mark_free(size_t i)
+{
+    Chunk& c = chunk_of(i);
+    const size_t n = local_index(i);
+    const uint64_t bit = uint64_t{ 1 } << (n % BITS_PER_WORD);
+    c.usedMask[n / BITS_PER_WORD] &= ~bit;
+    c.activeMask[n / BITS_PER_WORD] &= ~bit;
+    while (c.wordEnd > 0 && c.usedMask[c.wordEnd - 1] == 0)
+    {
+        c.wordEnd--;
+    }
+}
+
+void LinearMotionSystem::set_active(const LinearBlock& block, bool active)
+{
+    Chunk& c = chunk_of(block.first.index());
+    const size_t first = local_index(block.first.index());
+    for (size_t n = first; n < first + block.count;)
+    {
+        // whole words at once, the block is not necessarily word aligned at either end
+        const size_t bit = n % BITS_PER_WORD;
+        const size_t bits = std::min(BITS_PER_WORD - bit, first + block.count - n);
+        const uint64_t mask = (bits == BITS_PER_WORD ? ~uint64_t{ 0 } : (uint64_t{ 1 } << bits) - 1) << bit;
+        uint64_t& word = c.activeMask[n / BITS_PER_WORD];
+        word = active ? word | (mask & c.usedMask[n / BITS_PER_WORD]) : word & ~mask;
+        n += bits;
+    }
+}
+
+void LinearMotionSystem::add_to_velocity(Chunk& chunk, size_t i, const math::vec3& velocity)
+{
+    chunk.velocities.set(i, chunk.velocities.get(i) + velocity);
+    if constexpr (Integrator::keeps_previous_position)
+    {
+        chunk.previousPositions.set(i, chunk.previousPositions.get(i) - velocity * this->timeStep);
+    }
+}
+
+void LinearMotionSystem::reset_previous_position(Chunk& chunk, size_t i)
+{
+    if constexpr (Integrator::keeps_previous_position)
     {
-        linearDataPool[i].im = 1.f / mass;
+        chunk.previousPositions.set(i, chunk.positions.get(i) - chunk.velocities.get(i) * this->timeStep);
     }
 }
 
-void LinearMotionSystem::update_data()
+void LinearMotionSystem::update_data(float dt)
 {
-    for (size_t n = 0; n < this->size; n++)
+    DBG_VALID_FLOAT(dt);
+    DBG_ASSERT(dt > 0.f);
+
+    if (!(dt > 0.f))
+    {
+        return;
+    }
+
+    StepParameters step;
+    step.dt = dt;
+    step.previousDt = this->timeStep;
+    step.damping = std::pow(PHYSICS_DAMPING_FACTOR, dt / PHYSICS_TIME_STEP); // <- same decay per second whatever the step
+
+    // every chunk holds the same number of words, the words of a chunk past its wordEnd are all zero
+    const size_t wordsPerChunk = this->chunkSize / BITS_PER_WORD;
+    size_t wordCount = 0;
+    for (size_t n = 0; n < chunks.size(); n++)
+    {
+        if (chunks[n]->wordEnd > 0)
+        {
+            wordCount = n * wordsPerChunk + chunks[n]->wordEnd;
+        }
+    }
+
+    float maxSpeed2 = 0.f;
+    if (threadPool == nullptr || wordCount < PARALLEL_MIN_WORDS)
+    {
+        maxSpeed2 = update_words(0, wordCount, step);
+    }
+    else
     {
-        if (linearDataUsed[n] && !linearDataSkip[n])
+        // a range is a whole number of words, so with cache line aligned arrays no two threads write the same line
+        rangeMaxSpeed2.assign((wordCount + PARALLEL_GRAIN_WORDS - 1) / PARALLEL_GRAIN_WORDS, 0.f);
+        threadPool->parallel_for(wordCount, PARALLEL_GRAIN_WORDS, [this, &step](size_t begin, size_t end) {
+            rangeMaxSpeed2[begin / PARALLEL_GRAIN_WORDS] = update_words(begin, end, step);
+        });
+        for (const float s : rangeMaxSpeed2)
         {
-            linearDataPool[n].v = linearDataPool[n].v * PHYSICS_DAMPING_FACTOR + linearDataPool[n].f * linearDataPool[n].im * PHYSICS_TIME_STEP;
-            linearDataPool[n].p += linearDataPool[n].v * PHYSICS_TIME_STEP;
-            linearDataPool[n].f = math::vec3();
+            maxSpeed2 = std::max(maxSpeed2, s);
         }
     }
+    this->maxSpeed = std::sqrt(maxSpeed2);
+    this->timeStep = dt;
+}
+
+void LinearMotionSystem::set_thread_pool(ThreadPool* pool)
+{
+    this->threadPool = pool;
+}
+
+ThreadPool* LinearMotionSystem::thread_pool() const
+{
+    return this->threadPool;
+}
+
+float LinearMotionSystem::time_step() const
+{
+    return this->timeStep;
+}
+
+float LinearMotionSystem::max_linear_speed() const
+{
+    return this->maxSpeed;
+}
+
+float LinearMotionSystem::update_words(size_t begin, size_t end, const StepParameters& step)
+{
+    constexpr size_t width = SIMD_MAX_WIDTH; // <- the widest kernel, the narrower ones loop over it
+    constexpr uint64_t fullWord = ~uint64_t{ 0 };
+    constexpr uint64_t fullGroup = (uint64_t{ 1 } << width) - 1;
+
+    const LinearKernels& kernels = select_kernels<LinearKernels>();
+    const integrators::StepConstants<float> kScalar(step.dt, step.previousDt, step.damping);
+
+    float maxSpeed2 = 0.f;
+    const size_t wordsPerChunk = this->chunkSize / BITS_PER_WORD;
+    for (size_t global = begin; global < end; global++)
+    {
+        Chunk& c = *chunks[global / wordsPerChunk];
+        const LinearLanes lanes{
+            { c.positions.x_data(), c.positions.y_data(), c.positions.z_data() },
+            { c.velocities.x_data(), c.velocities.y_data(), c.velocities.z_data() },
+            { c.previousPositions.x_data(), c.previousPositions.y_data(), c.previousPositions.z_data() },
+            { c.forces.x_data(), c.forces.y_data(), c.forces.z_data() },
+            c.inverseMasses.get()
+        };
+        const size_t w = global % wordsPerChunk;
+        const uint64_t word = c.activeMask[w];
+        const size_t base = w * BITS_PER_WORD;
+        if (word == 0)
+        {
+            continue;
+        }
+        if (word == fullWord)
+        {
+            maxSpeed2 = std::max(maxSpeed2, kernels.integrate(lanes, base, base + BITS_PER_WORD, step.dt, step.previousDt, step.damping));
+            continue;
+        }
+
+        // whole groups of active particles go through the vector kernel, partially active ones fall back to scalar
+        for (size_t lane = 0; lane < BITS_PER_WORD; lane += width)
+        {
+            uint64_t bits = (word >> lane) & fullGroup;
+            if (bits == fullGroup)
+            {
+                maxSpeed2 = std::max(maxSpeed2, kernels.integrate(lanes, base + lane, base + lane + width, step.dt, step.previousDt, step.damping));
+            }
+            else
+            {
+                for (; bits != 0; bits &= bits - 1)
+                {
+                    const size_t i = base + lane + count_trailing_zeros(bits);
+                    maxSpeed2 = std::max(maxSpeed2, integrate_linear<Integrator>(lanes, i, i + 1, kScalar));
+                }
+            }
+        }
+    }
+    return maxSpeed2;
+}
+
+size_t LinearMotionSystem::capacity() const
+{
+    return chunks.size() * this->chunkSize;
 }
 
 bool LinearMotionSystem::wrong_init() const
 {
-    return this->size == 0;
+    return this->chunkSize == 0;
 }
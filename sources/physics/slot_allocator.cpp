@@ -0,0 +1,131 @@
+#include "physics/slot_allocator.h"
+#include "macro.h"
+
+#include <algorithm>
+
+SlotAllocator::SlotAllocator(size_t capacity, size_t pageSize)
+    : size{ 0u }
+    , pageSize{ pageSize }
+    , end{ 0u }
+    , freeHead{ END_OF_LIST }
+{
+    DBG_ASSERT(pageSize > 0);
+    grow(capacity);
+}
+
+void SlotAllocator::grow(size_t count)
+{
+    DBG_ASSERT(this->size + count <= SlotHandle::MAX_SLOTS);
+
+    this->size = std::min<size_t>(this->size + count, SlotHandle::MAX_SLOTS);
+    generations.resize(this->size, 0u);
+    links.resize(this->size, END_OF_LIST);
+}
+
+SlotHandle SlotAllocator::allocate()
+{
+    uint32_t index;
+    if (this->freeHead != END_OF_LIST)
+    {
+        index = this->freeHead;
+        this->freeHead = links[index];
+    }
+    else if (this->end < this->size)
+    {
+        index = this->end++;
+    }
+    else if (!freeRanges.empty())
+    {
+        Range& range = freeRanges.back();
+        index = range.first++;
+        if (--range.count == 0)
+        {
+            freeRanges.pop_back();
+        }
+    }
+    else
+    {
+        return {};
+    }
+    return { index, generations[index] };
+}
+
+bool SlotAllocator::release(SlotHandle handle)
+{
+    DBG_ASSERT(is_valid(handle));
+
+    if (is_valid(handle))
+    {
+        const uint32_t index = handle.index();
+        generations[index] = (generations[index] + 1u) & SlotHandle::GENERATION_MASK;
+        links[index] = this->freeHead;
+        this->freeHead = index;
+        return true;
+    }
+    return false;
+}
+
+SlotHandle SlotAllocator::allocate_range(size_t count)
+{
+    DBG_ASSERT(count > 0 && count <= this->pageSize);
+
+    if (count == 0 || count > this->pageSize)
+    {
+        return {};
+    }
+    for (size_t n = 0; n < freeRanges.size(); n++) // <- first fit among the released runs
+    {
+        Range& range = freeRanges[n];
+        if (range.count >= count)
+        {
+            const uint32_t index = range.first;
+            range.first += static_cast<uint32_t>(count);
+            range.count -= static_cast<uint32_t>(count);
+            if (range.count == 0)
+            {
+                freeRanges.erase(freeRanges.begin() + n);
+            }
+            return { index, generations[index] };
+        }
+    }
+    size_t index = this->end;
+    const size_t pageEnd = (index / this->pageSize + 1) * this->pageSize;
+    if (index + count > pageEnd) // <- the run would straddle two pages, it starts on the next one instead
+    {
+        index = pageEnd;
+    }
+    if (index + count <= this->size)
+    {
+        if (index != this->end)
+        {
+            freeRanges.push_back({ this->end, static_cast<uint32_t>(index - this->end) });
+        }
+        this->end = static_cast<uint32_t>(index + count);
+        return { static_cast<uint32_t>(index), generations[index] };
+    }
+    return {};
+}
+
+bool SlotAllocator::release_range(SlotHandle first, size_t count)
+{
+    DBG_ASSERT(is_valid(first));
+    DBG_ASSERT(first.index() + count <= this->end);
+
+    if (is_valid(first) && first.index() + count <= this->end)
+    {
+        for (uint32_t index = first.index(); index < first.index() + count; index++)
+        {
+            generations[index] = (generations[index] + 1u) & SlotHandle::GENERATION_MASK;
+        }
+        if (first.index() + count == this->end)
+        {
+            this->end = first.index(); // <- the run was the last one handed out, give it back to the untouched tail
+        }
+        else
+        {
+            freeRanges.push_back({ first.index(), static_cast<uint32_t>(count) });
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,28 @@
+#include "physics/time_step_controller.h"
+#include "macro.h"
+
+#include <algorithm>
+
+TimeStepController::TimeStepController(float lengthScale, float minStep, float maxStep, float cfl, float growth)
+    : maxDisplacement{ cfl * lengthScale }
+    , minStep{ minStep }
+    , maxStep{ std::max(minStep, maxStep) }
+    , growth{ std::max(1.f, growth) }
+    , step{ minStep }
+{
+    DBG_ASSERT(lengthScale > 0.f && cfl > 0.f);
+    DBG_ASSERT(minStep > 0.f && minStep <= maxStep);
+}
+
+float TimeStepController::next(float maxSpeed)
+{
+    DBG_VALID_FLOAT(maxSpeed);
+
+    float target = this->maxStep;
+    if (maxSpeed * this->maxStep > this->maxDisplacement)
+    {
+        target = this->maxDisplacement / maxSpeed;
+    }
+    this->step = std::clamp(std::min(target, this->step * this->growth), this->minStep, this->maxStep);
+    return this->step;
+}
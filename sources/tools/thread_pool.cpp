@@ -0,0 +1,105 @@
+#include "tools/thread_pool.h"
+#include "macro.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(threadCount - 1);
+    for (size_t n = 1; n < threadCount; n++)
+    {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain, const Task& task)
+{
+    DBG_ASSERT(grain > 0);
+
+    if (grain == 0)
+    {
+        grain = 1;
+    }
+    if (workers.empty() || count <= grain) // <- a single range is not worth waking anyone up
+    {
+        if (count > 0)
+        {
+            task(0, count);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->count = count;
+        this->grain = grain;
+        this->nextRange.store(0, std::memory_order_relaxed);
+        this->pendingWorkers = workers.size();
+        this->job++;
+    }
+    wakeUp.notify_all();
+
+    run_ranges();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this] { return this->pendingWorkers == 0; });
+    this->task = nullptr;
+}
+
+void ThreadPool::worker_loop()
+{
+    uint64_t lastJob = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this, lastJob] { return this->stopping || this->job != lastJob; });
+            if (this->stopping)
+            {
+                return;
+            }
+            lastJob = this->job;
+        }
+
+        run_ranges();
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = --this->pendingWorkers == 0;
+        }
+        if (last)
+        {
+            jobDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run_ranges()
+{
+    const size_t rangeCount = (this->count + this->grain - 1) / this->grain;
+    for (size_t range = nextRange.fetch_add(1, std::memory_order_relaxed); range < rangeCount;
+         range = nextRange.fetch_add(1, std::memory_order_relaxed))
+    {
+        const size_t begin = range * this->grain;
+        (*this->task)(begin, std::min(begin + this->grain, this->count));
+    }
+}